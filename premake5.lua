@@ -31,6 +31,7 @@ glad_src = {
 }
 
 stdgl_src = {
+	"src/stdgl_config.h",
 	"src/stdgl.h",
 	"src/stdgl.cpp"
 }
@@ -46,6 +47,7 @@ imguizmo_src = {
 }
 
 lib_src = { imgui_src, glad_src, stdgl_src, implot_src, imguizmo_src}
+bench_lib_src = { imgui_src, glad_src, stdgl_src }
 
 libs = {}
 libs["GLFW"] = "libs/glfw/x64/release"
@@ -75,7 +77,8 @@ project "stdgl_examples"
 	files {"%{prj.name}/src/**.h", "%{prj.name}/src/**.cpp", lib_src}
 	
 	defines {
-		"STDGL_LOG"
+		"STDGL_LOG",
+		"STDGL_PROFILE"
 	}
 
 	includedirs {
@@ -127,3 +130,75 @@ project "stdgl_examples"
 			"zlibstatic"
 		}
 
+
+-- Benchmark project
+--  Headless, writes results as JSON: stdgl_bench --out results.json
+project "stdgl_bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin/int/" .. outputdir .. "/%{prj.name}")
+	location "%{prj.name}"
+
+	files {"%{prj.name}/src/**.h", "%{prj.name}/src/**.cpp", bench_lib_src}
+
+	includedirs {
+		"src",
+		"%{prj.name}/src",
+		"%{includes.GLFW}",
+		"%{includes.Glad}",
+		"%{includes.GLM}",
+		"%{includes.spdlog}",
+		"%{includes.imgui}",
+		"%{includes.stb}",
+		"%{includes.assimp}"
+	}
+
+	libdirs {
+		"%{libs.GLFW}",
+		"%{libs.assimp}"
+	}
+
+	postbuildcommands {
+		"{COPY} res/ %{cfg.targetdir}/res/"
+	}
+
+	filter "system:windows"
+		systemversion "latest"
+		links {
+			"glfw3",
+			"opengl32.lib",
+		}
+
+	-- Build agents without a display render through EGL (Mesa llvmpipe)
+	filter "system:linux"
+		defines { "STDGL_HEADLESS_EGL" }
+		links {
+			"glfw",
+			"EGL",
+			"GL",
+			"assimp",
+			"pthread",
+			"dl"
+		}
+
+	filter "configurations:Debug"
+		defines { "DEBUG"}
+		symbols "On"
+
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+		optimize "On"
+
+	filter { "system:windows", "configurations:Debug" }
+		links {
+			"assimp-vc142-mtd",
+			"zlibstaticd"
+		}
+
+	filter { "system:windows", "configurations:Release" }
+		links {
+			"assimp-vc142-mt",
+			"zlibstatic"
+		}
@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
 
 #ifdef STDGL_LOG
 #include <spdlog/spdlog.h>
@@ -16,7 +17,49 @@
 #include <map>
 #include <set>
 #include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <fstream>
+#include <iomanip>
+#include <filesystem>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+	#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+	#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define STDGL_SSE
+#endif
+
+#ifdef STDGL_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -54,6 +97,47 @@ namespace stdgl {
 	#define STDGL_ASSERT(x) assert(x)
 
 
+	//---------------------------------------------------------------
+	// [SECTION] Configuration
+	//---------------------------------------------------------------
+
+	// Frames the CPU may run ahead of the GPU, sizes the fenced streaming rings
+	#ifndef STDGL_FRAMES_IN_FLIGHT
+	#define STDGL_FRAMES_IN_FLIGHT 3
+	#endif
+
+	// Frames of latency before GPU zone results are read back
+	#ifndef STDGL_GPU_PROFILER_FRAMES
+	#define STDGL_GPU_PROFILER_FRAMES (STDGL_FRAMES_IN_FLIGHT + 1)
+	#endif
+
+	// CPU zones kept per thread while capturing, must be a power of two. Rings are allocated on a thread's first captured zone
+	#ifndef STDGL_CPU_PROFILER_EVENTS
+	#define STDGL_CPU_PROFILER_EVENTS 65536
+	#endif
+
+	// Frame times kept for getFrameStats
+	#ifndef STDGL_FRAME_HISTORY
+	#define STDGL_FRAME_HISTORY 1024
+	#endif
+
+	// Post-transform vertex cache size assumed by optimizeMesh and analyzeVertexCache
+	#ifndef STDGL_VERTEX_CACHE_SIZE
+	#define STDGL_VERTEX_CACHE_SIZE 32
+	#endif
+
+	// Allow 8-bit indices for meshes with at most 256 vertices, off by default since
+	// most desktop GPUs widen them to 16-bit on the fly
+	#ifndef STDGL_BYTE_INDICES
+	#define STDGL_BYTE_INDICES 0
+	#endif
+
+	// Model caches and program binaries are written here unless setCacheDirectory picks another directory
+	#ifndef STDGL_CACHE_DIRECTORY
+	#define STDGL_CACHE_DIRECTORY "stdgl_cache"
+	#endif
+
+
 	//---------------------------------------------------------------
 	// [SECTION] Hash functions
 	//---------------------------------------------------------------
@@ -106,6 +190,36 @@ namespace stdgl {
 		return ~crc;
 	}
 
+	// MurmurHash64A (Austin Appleby, public domain), 8 bytes per step for content addressing of large buffers
+	uint64_t hashBytes64(const void* data, size_t size, uint64_t seed) {
+		const uint64_t multiplier = 0xc6a4a7935bd1e995ull;
+		uint64_t hash = seed ^ (size * multiplier);
+
+		const unsigned char* bytes = (const unsigned char*)data;
+		const unsigned char* end = bytes + size / 8 * 8;
+		for (; bytes != end; bytes += 8) {
+			uint64_t word;
+			std::memcpy(&word, bytes, 8);
+			word *= multiplier;
+			word ^= word >> 47;
+			word *= multiplier;
+			hash ^= word;
+			hash *= multiplier;
+		}
+
+		if ((size & 7) != 0) {
+			uint64_t tail = 0;
+			std::memcpy(&tail, bytes, size & 7);
+			hash ^= tail;
+			hash *= multiplier;
+		}
+
+		hash ^= hash >> 47;
+		hash *= multiplier;
+		hash ^= hash >> 47;
+		return hash;
+	}
+
 
 	//---------------------------------------------------------------
 	// [SECTION] Context definition
@@ -141,6 +255,24 @@ namespace stdgl {
 		return content;
 	}
 
+	static std::string g_cacheDirectory = STDGL_CACHE_DIRECTORY;
+
+	void setCacheDirectory(const std::string& directory) {
+		g_cacheDirectory = directory;
+	}
+
+	// Created on the first write, reading from a missing directory just misses
+	void createCacheDirectory() {
+		if (!g_cacheDirectory.empty()) {
+			std::error_code error;
+			std::filesystem::create_directories(g_cacheDirectory, error);
+		}
+	}
+
+	const std::string& getCacheDirectory() {
+		return g_cacheDirectory;
+	}
+
 
 	//---------------------------------------------------------------
 	// [SECTION] Context
@@ -155,8 +287,23 @@ namespace stdgl {
 		STDGL_LOG_DEBUG("Context initialize");
 	}
 
+	void destroyUniformRing();
+	void destroyResources();
+	void destroyTextureStreaming();
+	void stopWorkerPool();
+	void destroyGPUProfiler();
+	void destroyOcclusion();
+	void shutdownHeadless();
+
 	void shutdown(Context* context) {
 		STDGL_LOG_DEBUG("Context shutdown");
+		stopWorkerPool();
+		destroyGPUProfiler();
+		destroyOcclusion();
+		destroyResources();
+		destroyTextureStreaming();
+		destroyUniformRing();
+		shutdownHeadless();
 	}
 
 	StdGLID getIDWithSeed(unsigned int seed, const char* str, const char* str_end = nullptr) {
@@ -212,6 +359,142 @@ namespace stdgl {
 	}
 
 
+	//---------------------------------------------------------------
+	// [SECTION] State cache
+	//---------------------------------------------------------------
+
+	void StateCache::invalidate() {
+		program = UNKNOWN;
+		vertexArray = UNKNOWN;
+		framebuffer = UNKNOWN;
+		activeTextureUnit = UNKNOWN;
+		for (GLuint& texture : textures) {
+			texture = UNKNOWN;
+		}
+		blend = -1;
+		depthTest = -1;
+		cullFace = -1;
+	}
+
+	// Returns true if the call has to be issued, without a context every call is issued
+	template<typename T>
+	bool updateCachedState(T StateCache::* member, T value) {
+		if (g_stdglContext == nullptr) {
+			return true;
+		}
+
+		StateCache& cache = g_stdglContext->stateCache;
+		if (cache.*member == value) {
+			++cache.elidedCalls;
+			return false;
+		}
+		cache.*member = value;
+		++cache.issuedCalls;
+		return true;
+	}
+
+	void bindProgram(GLuint program) {
+		if (updateCachedState(&StateCache::program, program)) {
+			glUseProgram(program);
+		}
+	}
+
+	void bindVertexArray(GLuint vertexArray) {
+		if (updateCachedState(&StateCache::vertexArray, vertexArray)) {
+			glBindVertexArray(vertexArray);
+		}
+	}
+
+	// Bound in place of framebuffer 0, the offscreen target when running headless
+	static GLuint g_defaultFramebuffer = 0;
+
+	void bindFramebuffer(GLuint framebuffer) {
+		if (framebuffer == 0) {
+			framebuffer = g_defaultFramebuffer;
+		}
+		if (updateCachedState(&StateCache::framebuffer, framebuffer)) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		}
+	}
+
+	void setActiveTextureUnit(GLuint unit) {
+		if (updateCachedState(&StateCache::activeTextureUnit, unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+	}
+
+	void bindTexture2D(GLuint unit, GLuint textureID) {
+		if (g_stdglContext == nullptr || unit >= StateCache::TEXTURE_UNITS) {
+			setActiveTextureUnit(unit);
+			glBindTexture(GL_TEXTURE_2D, textureID);
+			return;
+		}
+
+		// Always select the unit, callers edit the texture bound to the active unit
+		setActiveTextureUnit(unit);
+
+		StateCache& cache = g_stdglContext->stateCache;
+		if (cache.textures[unit] == textureID) {
+			++cache.elidedCalls;
+			return;
+		}
+		cache.textures[unit] = textureID;
+		++cache.issuedCalls;
+		glBindTexture(GL_TEXTURE_2D, textureID);
+	}
+
+	void setCapability(int StateCache::* member, GLenum capability, bool enabled) {
+		if (updateCachedState(member, (int)enabled)) {
+			if (enabled) {
+				glEnable(capability);
+			}
+			else {
+				glDisable(capability);
+			}
+		}
+	}
+
+	// Deleted objects are unbound by GL, their names may be reused
+	void forgetTexture(GLuint textureID) {
+		if (g_stdglContext == nullptr) {
+			return;
+		}
+		for (GLuint& texture : g_stdglContext->stateCache.textures) {
+			if (texture == textureID) {
+				texture = 0;
+			}
+		}
+	}
+
+	void forgetFramebuffer(GLuint framebufferID) {
+		if (g_stdglContext != nullptr && g_stdglContext->stateCache.framebuffer == framebufferID) {
+			g_stdglContext->stateCache.framebuffer = 0;
+		}
+	}
+
+	// Implementation
+	void setBlending(bool enabled) {
+		setCapability(&StateCache::blend, GL_BLEND, enabled);
+	}
+
+	void setDepthTest(bool enabled) {
+		setCapability(&StateCache::depthTest, GL_DEPTH_TEST, enabled);
+	}
+
+	void setFaceCulling(bool enabled) {
+		setCapability(&StateCache::cullFace, GL_CULL_FACE, enabled);
+	}
+
+	void invalidateStateCache() {
+		g_stdglContext->stateCache.invalidate();
+	}
+
+	StateCacheStats getStateCacheStats() {
+		const StateCache& cache = g_stdglContext->stateCache;
+		return { cache.lastIssuedCalls, cache.lastElidedCalls };
+	}
+
+
 	//---------------------------------------------------------------
 	// [SECTION] Setup
 	//---------------------------------------------------------------
@@ -266,6 +549,15 @@ namespace stdgl {
 		return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 	}
 
+	// Through the loader of the API that created the context
+	void* getGLProcAddress(const char* name) {
+	#ifdef STDGL_HEADLESS_EGL
+		return (void*)eglGetProcAddress(name);
+	#else
+		return (void*)glfwGetProcAddress(name);
+	#endif
+	}
+
 	bool setupDebug() {
 		// Requires: glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
 		int flags; glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
@@ -314,6 +606,214 @@ namespace stdgl {
 	}
 
 
+	//// Headless
+	#ifdef STDGL_HEADLESS_EGL
+	#ifndef EGL_PLATFORM_SURFACELESS_MESA
+	#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+	#endif
+	#endif
+
+	struct HeadlessData {
+		bool active;
+		int width, height;
+		GLuint framebufferID;
+
+		#ifdef STDGL_HEADLESS_EGL
+		EGLDisplay display;
+		EGLContext context;
+		EGLSurface surface; // Only when surfaceless contexts are unsupported
+		#endif
+		GLFWwindow* window;
+
+		HeadlessData() : active(false), width(0), height(0), framebufferID(0),
+		#ifdef STDGL_HEADLESS_EGL
+			display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE),
+		#endif
+			window(nullptr) {}
+	};
+
+	static HeadlessData g_headless;
+
+	#ifdef STDGL_HEADLESS_EGL
+	// Mesa surfaceless platform (llvmpipe without a display), falls back to the default display
+	bool createHeadlessContext() {
+		HeadlessData& headless = g_headless;
+
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay != nullptr) {
+			headless.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+		if (headless.display == EGL_NO_DISPLAY) {
+			headless.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+
+		EGLint major, minor;
+		if (headless.display == EGL_NO_DISPLAY || !eglInitialize(headless.display, &major, &minor)) {
+			STDGL_LOG_ERROR("Failed to initialize EGL display");
+			return false;
+		}
+		STDGL_LOG_DEBUG_F("EGL {}.{}", major, minor);
+
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(headless.display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			STDGL_LOG_ERROR("No EGL config for desktop OpenGL");
+			return false;
+		}
+
+		eglBindAPI(EGL_OPENGL_API);
+
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 4,
+			EGL_CONTEXT_MINOR_VERSION, 6,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		headless.context = eglCreateContext(headless.display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (headless.context == EGL_NO_CONTEXT) {
+			STDGL_LOG_ERROR("Failed to create EGL context");
+			return false;
+		}
+
+		// Rendering goes to the offscreen framebuffer, a pbuffer is only needed to make the context current
+		if (!eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless.context)) {
+			const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+			headless.surface = eglCreatePbufferSurface(headless.display, config, surfaceAttributes);
+			if (headless.surface == EGL_NO_SURFACE || !eglMakeCurrent(headless.display, headless.surface, headless.surface, headless.context)) {
+				STDGL_LOG_ERROR("Failed to make EGL context current");
+				return false;
+			}
+		}
+
+		return gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+	}
+	#else
+	// Hidden GLFW window, GLFW 3.4+ runs without a display through the null platform and OSMesa
+	bool createHeadlessContext() {
+		HeadlessData& headless = g_headless;
+
+		#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		#endif
+		if (!glfwInit()) {
+			STDGL_LOG_ERROR("Failed to initialize GLFW");
+			return false;
+		}
+
+		#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		#endif
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+		headless.window = glfwCreateWindow(1, 1, "stdgl_headless", nullptr, nullptr);
+		if (headless.window == nullptr) {
+			STDGL_LOG_ERROR("Failed to create headless GLFW context");
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(headless.window);
+
+		return setupGLAD();
+	}
+	#endif
+
+	bool setupHeadless(int width, int height) {
+		STDGL_ASSERT(g_stdglContext != nullptr);
+
+		HeadlessData& headless = g_headless;
+		if (headless.active) {
+			return false;
+		}
+
+		if (!createHeadlessContext()) {
+			shutdownHeadless();
+			return false;
+		}
+		headless.active = true;
+		headless.width = width;
+		headless.height = height;
+
+		g_stdglContext->stateCache.invalidate();
+		setRendererSize(width, height);
+
+		if (beginFramebuffer("__stdglHeadless", width, height)) {
+			addAttachment(FramebufferAttachmentType::COLOR);
+			addAttachment(FramebufferAttachmentType::DEPTH);
+			buildFramebuffer();
+			headless.framebufferID = getFramebufferID();
+			endFramebuffer();
+		}
+
+		if (headless.framebufferID == 0) {
+			STDGL_LOG_ERROR("Failed to create headless framebuffer");
+			shutdownHeadless();
+			return false;
+		}
+
+		g_defaultFramebuffer = headless.framebufferID;
+		g_stdglContext->stateCache.framebuffer = StateCache::UNKNOWN;
+		bindFramebuffer(0);
+		glViewport(0, 0, width, height);
+
+		STDGL_LOG_DEBUG_F("Headless context: {}", (const char*)glGetString(GL_RENDERER));
+		return true;
+	}
+
+	bool isHeadless() {
+		return g_headless.active;
+	}
+
+	std::vector<unsigned char> readHeadlessFrame() {
+		std::vector<unsigned char> pixels;
+		if (!g_headless.active) {
+			return pixels;
+		}
+
+		pixels.resize((size_t)g_headless.width * g_headless.height * 4);
+		bindFramebuffer(0);
+		// Tightly packed rows, restore the caller's alignment afterwards
+		GLint previousAlignment = 4;
+		glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, g_headless.width, g_headless.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+		return pixels;
+	}
+
+	void shutdownHeadless() {
+		HeadlessData& headless = g_headless;
+		g_defaultFramebuffer = 0;
+
+		#ifdef STDGL_HEADLESS_EGL
+		if (headless.display != EGL_NO_DISPLAY) {
+			eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (headless.surface != EGL_NO_SURFACE) {
+				eglDestroySurface(headless.display, headless.surface);
+			}
+			if (headless.context != EGL_NO_CONTEXT) {
+				eglDestroyContext(headless.display, headless.context);
+			}
+			eglTerminate(headless.display);
+		}
+		#else
+		if (headless.window != nullptr) {
+			glfwDestroyWindow(headless.window);
+			glfwTerminate();
+		}
+		#endif
+
+		headless = HeadlessData();
+	}
+
+
 	//---------------------------------------------------------------
 	// [SECTION] ImGui
 	//---------------------------------------------------------------
@@ -340,6 +840,11 @@ namespace stdgl {
 	void renderImGui() {
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+		// The backend binds its own state
+		if (g_stdglContext != nullptr) {
+			invalidateStateCache();
+		}
 	}
 
 	void shutdownImGui() {
@@ -353,18 +858,68 @@ namespace stdgl {
 	// [SECTION] Texture
 	//---------------------------------------------------------------
 
-	static std::vector<GLuint> g_loadedTextures;
+	//// Resource pools
+	// Slots are recycled through a free list, destroying one advances its generation so stale handles miss.
+	// A slot stays in use at a reference count of 0 until it is destroyed, cached textures rely on that.
+	template<typename T>
+	struct ResourcePool {
+		struct Slot {
+			T resource;
+			uint32_t generation;
+			uint32_t refCount;
+			bool used;
+		};
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+
+		// Starts with one reference
+		ResourceHandle create(T&& resource) {
+			uint32_t index;
+			if (!freeSlots.empty()) {
+				index = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else {
+				index = (uint32_t)slots.size();
+				slots.push_back({ T(), 1, 0, false });
+			}
+
+			Slot& slot = slots[index];
+			slot.resource = std::move(resource);
+			slot.refCount = 1;
+			slot.used = true;
+			return { index, slot.generation };
+		}
+
+		// nullptr for stale and unmanaged handles
+		Slot* find(ResourceHandle handle) {
+			if (handle.generation == 0 || handle.index >= slots.size() || slots[handle.index].generation != handle.generation) {
+				return nullptr;
+			}
+			return &slots[handle.index];
+		}
+
+		void destroy(ResourceHandle handle) {
+			Slot& slot = slots[handle.index];
+			slot.resource = T();
+			slot.refCount = 0;
+			slot.used = false;
+			if (++slot.generation == 0) {
+				slot.generation = 1;
+			}
+			freeSlots.push_back(handle.index);
+		}
+	};
 
+	// Owned by the caller, textures loaded through loadTexture are tracked by the texture cache
 	GLuint createTexture() {
 		GLuint textureID;
 		glGenTextures(1, &textureID);
 		STDGL_LOG_TRACE_F("New texture ID generated: {}", textureID);
-		g_loadedTextures.push_back(textureID);
 		return textureID;
 	}
 
-	static std::map<std::string, Texture> g_texturesCache;
-
 	GLenum channelsToFormat(int channels, bool reversed = false) {
 		STDGL_ASSERT(channels <= 4);
 
@@ -381,434 +936,2635 @@ namespace stdgl {
 		return format;
 	}
 
-	GLuint loadTextureInternal(unsigned char* data, int width, int height, int channels, GLenum format) {
-		STDGL_ASSERT(data != nullptr);
-
+	// Immutable storage with a full mip chain
+	GLuint allocateTexture(int width, int height) {
 		GLuint textureID = createTexture();
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		bindTexture2D(0, textureID);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		//glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLsizei levels = 1;
+		for (int size = std::max(width, height); size > 1; size >>= 1) {
+			++levels;
+		}
+		glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
 
 		return textureID;
 	}
 
-	Texture loadTexture(const std::string& sourcePath, const TextureType& type) {
-
-		auto it = g_texturesCache.find(sourcePath);
-
-		if (it != g_texturesCache.end()) {
-			STDGL_LOG_TRACE_F("Returning cached texture: {}", sourcePath);
-			return Texture(it->second);
-		}
-		STDGL_LOG_TRACE_F("Loading texture from: {}", sourcePath);
-
-		int width, height, channels;
-		unsigned char* data = stbi_load(sourcePath.c_str(), &width, &height, &channels, 0);
+	GLuint loadTextureInternal(unsigned char* data, int width, int height, int channels, GLenum format) {
+		STDGL_ASSERT(data != nullptr);
 
-		GLenum format = channelsToFormat(channels);
-		GLuint textureID = loadTextureInternal(data, width, height, channels, format);
+		GLuint textureID = allocateTexture(width, height);
 
-		stbi_image_free(data);
+		// Tightly packed rows, restore the caller's alignment afterwards
+		GLint previousAlignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+		glGenerateMipmap(GL_TEXTURE_2D);
 
-		g_texturesCache[sourcePath] = Texture{ textureID, type, (unsigned int)width, (unsigned int)height, (unsigned int)channels, format, sourcePath };
-		return Texture(g_texturesCache[sourcePath]);
+		return textureID;
 	}
 
-	Texture loadEmbeddedTexture(const aiTexture* texture, const TextureType& type, const std::string& signature) {
-		auto it = g_texturesCache.find(signature);
-
-		if (it != g_texturesCache.end()) {
-			STDGL_LOG_TRACE_F("Returning cached embedded texture: {}", signature);
-			return Texture(it->second);
-		}
-		STDGL_LOG_TRACE_F("Loading embedded texture from: {}", signature);
+	//// Streaming
+	#ifndef STDGL_TEXTURE_STREAM_BYTES_PER_FRAME
+	#define STDGL_TEXTURE_STREAM_BYTES_PER_FRAME (8 << 20)
+	#endif
 
-		
-		// aiTexel is ordered BGRA
-		// Texture is always in ARGB8888 format
-		// if mHeight == 0 the data is compressed and stored in array of size mWidth
-		// else data is of length mHeight*mWidth
-		unsigned int dataSize;
-
-		// Check if data is compressed
-		if (texture->mHeight == 0) { // Texture is compressed
-			dataSize = texture->mWidth;
-			STDGL_LOG_TRACE("Texture is compressed");
-		}
-		else {
-			// Texture is not compressed
-			dataSize = texture->mWidth * texture->mHeight;
-			STDGL_LOG_TRACE("Texture is not compressed");
-		}
-		
-		const char* hint = texture->achFormatHint; // mHeight == 0 -> length 4 else length 9
+	struct TextureStreamJob {
+		GLuint textureID;
+		unsigned char* pixels; // Owned, stb allocated
 		int width, height, channels;
-		auto charsPerVertex = sizeof(aiTexel) / sizeof(unsigned char);
-		unsigned char* data = stbi_load_from_memory((unsigned char*)texture->pcData, dataSize * charsPerVertex, &width, &height, &channels, 0);
-
-		GLenum format = channelsToFormat(channels, true);
-		STDGL_LOG_TRACE_F("Channels: {}", channels);
-		GLuint textureID = loadTextureInternal(data, width, height, channels, format);
+		GLenum format;
+		int nextRow;
+	};
 
-		stbi_image_free(data);
+	// Persistently mapped unpack buffer with one region per frame in flight.
+	// Each frame copies rows of pending textures into the next free region and
+	// issues glTexSubImage2D from it, mips are generated once the last row is sent.
+	struct TextureStreamingData {
+		bool enabled;
 
-		g_texturesCache[signature] = Texture{ textureID, type, (unsigned int)width, (unsigned int)height, (unsigned int)channels, format, signature };
-		return Texture(g_texturesCache[signature]);
-	}
+		GLuint bufferID;
+		unsigned char* mapping;
+		GLsync fences[STDGL_FRAMES_IN_FLIGHT];
+		unsigned int region;
 
+		std::deque<TextureStreamJob> jobs;
+		std::unordered_set<GLuint> pending; // Texture IDs not yet ready
+		GLuint fallbackTextureID;
 
-	//---------------------------------------------------------------
-	// [SECTION] Mesh
-	//---------------------------------------------------------------
+		TextureStreamingData() : enabled(true), bufferID(0), mapping(nullptr), fences(), region(0), fallbackTextureID(0) {}
+	};
 
-	static std::vector<GLuint> g_loadedVAOS;
-	static std::vector<GLuint> g_loadedVBOS;
+	static TextureStreamingData g_textureStreaming;
 
-	GLuint createVAO() {
-		GLuint vao;
-		glGenVertexArrays(1, &vao);
-		g_loadedVAOS.push_back(vao);
-		return vao;
+	bool Texture::isReady() const {
+		return g_textureStreaming.pending.count(textureID) == 0;
 	}
 
-	GLuint createVBO() {
-		GLuint vbo;
-		glGenBuffers(1, &vbo);
-		g_loadedVBOS.push_back(vbo);
-		return vbo;
+	GLuint getFallbackTexture() {
+		if (g_textureStreaming.fallbackTextureID == 0) {
+			const unsigned char white[4] = { 255, 255, 255, 255 };
+			g_textureStreaming.fallbackTextureID = loadTextureInternal((unsigned char*)white, 1, 1, 4, GL_RGBA);
+		}
+		return g_textureStreaming.fallbackTextureID;
 	}
 
-	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<Texture>& textures) {
-		GLuint vao = createVAO();
-		GLuint vbo = createVBO();
-
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	GLuint getBindableTexture(const Texture& texture) {
+		return texture.isReady() && isTextureLoaded(texture) ? texture.textureID : getFallbackTexture();
+	}
 
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
+	void setTextureStreaming(bool enabled) {
+		g_textureStreaming.enabled = enabled;
+	}
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0); // Position
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal)); // Normal
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, textureCoordinate)); // Texture coordinate
+	// Takes ownership of the pixels
+	GLuint streamTexture(unsigned char*& pixels, int width, int height, int channels, GLenum format) {
+		STDGL_ASSERT(pixels != nullptr);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		return Mesh{ vertices, std::vector<unsigned int>(), textures, MeshType::ArrayMesh, vao, vbo, 0, mode, (GLsizei)vertices.size(), 0 };
+		GLuint textureID = allocateTexture(width, height);
+		g_textureStreaming.jobs.push_back({ textureID, pixels, width, height, channels, format, 0 });
+		g_textureStreaming.pending.insert(textureID);
+		pixels = nullptr;
+		return textureID;
 	}
 
-	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures) {
-		GLuint vao = createVAO();
-		GLuint vbo = createVBO();
-		GLuint ebo = createVBO();
-
-		glBindVertexArray(vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	void processTextureStreaming() {
+		TextureStreamingData& streaming = g_textureStreaming;
+		if (streaming.jobs.empty()) {
+			return;
+		}
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+		const GLsizeiptr regionSize = STDGL_TEXTURE_STREAM_BYTES_PER_FRAME;
+		if (streaming.bufferID == 0) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glGenBuffers(1, &streaming.bufferID);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streaming.bufferID);
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, regionSize * STDGL_FRAMES_IN_FLIGHT, nullptr, flags);
+			streaming.mapping = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, regionSize * STDGL_FRAMES_IN_FLIGHT, flags);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			STDGL_ASSERT(streaming.mapping != nullptr);
+		}
 
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
+		// Never stall, if the GPU still reads this region try again next frame
+		GLsync& fence = streaming.fences[streaming.region];
+		if (fence) {
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED) {
+				return;
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0); // Position
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal)); // Normal
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, textureCoordinate)); // Texture coordinate
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		const GLintptr regionOffset = (GLintptr)streaming.region * regionSize;
+		GLintptr offset = 0;
+
+		GLint previousAlignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streaming.bufferID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		while (!streaming.jobs.empty()) {
+			TextureStreamJob& job = streaming.jobs.front();
+			const GLintptr rowSize = (GLintptr)job.width * job.channels;
+
+			int rows = (int)std::min<GLintptr>(job.height - job.nextRow, (regionSize - offset) / rowSize);
+			if (rows <= 0) {
+				if (offset == 0) {
+					// A single row does not fit, upload directly from client memory
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+					bindTexture2D(0, job.textureID);
+					glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.nextRow, job.width, job.height - job.nextRow, job.format, GL_UNSIGNED_BYTE, job.pixels + job.nextRow * rowSize);
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streaming.bufferID);
+					job.nextRow = job.height;
+				}
+				else {
+					break;
+				}
+			}
+			else {
+				std::memcpy(streaming.mapping + regionOffset + offset, job.pixels + job.nextRow * rowSize, rows * rowSize);
+				bindTexture2D(0, job.textureID);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.nextRow, job.width, rows, job.format, GL_UNSIGNED_BYTE, (void*)(regionOffset + offset));
+				offset += rows * rowSize;
+				job.nextRow += rows;
+			}
 
-		return Mesh{ vertices, indices, textures, MeshType::ElementMesh, vao, vbo, ebo, mode, (GLsizei)vertices.size(), (GLsizei)indices.size() };
-	}
+			if (job.nextRow < job.height) {
+				break;
+			}
 
+			glGenerateMipmap(GL_TEXTURE_2D);
+			stbi_image_free(job.pixels);
+			streaming.pending.erase(job.textureID);
+			streaming.jobs.pop_front();
+		}
 
-	//---------------------------------------------------------------
-	// [SECTION] Camera utlities
-	//---------------------------------------------------------------
+		glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-	glm::mat4 Camera::getMatrix() const {
-		return glm::inverse(glm::translate(glm::mat4(1.0f), position) * glm::toMat4(glm::quat(rotation)));
+		if (offset > 0) {
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			streaming.region = (streaming.region + 1) % STDGL_FRAMES_IN_FLIGHT;
+		}
 	}
 
-	glm::mat4 Camera::generateProjection() const {
-		RenderContext& renderContext = g_stdglContext->renderContext;
-		return glm::perspectiveFov(fov, (float)renderContext.width, (float)renderContext.height, zNear, zFar);
-	}
+	void destroyTextureStreaming() {
+		TextureStreamingData& streaming = g_textureStreaming;
 
-	//---------------------------------------------------------------
-	// [SECTION] Shader
-	//---------------------------------------------------------------
+		for (TextureStreamJob& job : streaming.jobs) {
+			stbi_image_free(job.pixels);
+		}
+		streaming.jobs.clear();
+		streaming.pending.clear();
 
-	// Internal
-	struct ShaderData {
-		bool initialized;
+		for (GLsync& fence : streaming.fences) {
+			if (fence) {
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
 
-		GLuint programID;
+		if (streaming.bufferID != 0) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, streaming.bufferID);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &streaming.bufferID);
+			streaming.bufferID = 0;
+			streaming.mapping = nullptr;
+		}
+	}
 
-		std::map<unsigned int, std::string> attributes;
+	//// Lifetime
+	#ifndef STDGL_TEXTURE_BUDGET
+	#define STDGL_TEXTURE_BUDGET ((size_t)512 << 20)
+	#endif
 
-		// TODO: convert to sources
-		std::string vertexFilePath;
-		std::string fragmentFilePath;
-		
-		ShaderData() : initialized(false), programID(0), vertexFilePath(""), fragmentFilePath("") {}
+	struct TextureRecord {
+		Texture texture; // Copied out by cache hits
+		std::vector<std::string> signatures; // Every path or embedded signature that resolved to these pixels
+		uint64_t contentHash; // Of the encoded file or embedded bytes, 0 if unknown
+		size_t encodedSize; // Length of the hashed bytes, checked with the hash before aliasing
+		size_t bytes; // Estimated
+		uint64_t releaseOrder; // When the last reference was released, the LRU key
 	};
 
-	typedef std::map<StdGLID, ShaderData> ShaderDataMap;
-	static ShaderDataMap g_shaderDataMap;
-	static int g_shaderSeed = 0;
-
-
-	GLuint compileShader(const char* shaderSource, GLenum shaderType) {
-		GLuint shader = glCreateShader(shaderType);
+	// Textures are found by a hash of their signature first, then by a hash of their source bytes,
+	// so the same image under another path or embedded in another model shares one GL texture
+	struct TextureCacheData {
+		ResourcePool<TextureRecord> pool;
+		std::unordered_map<uint64_t, uint32_t> signatures; // Signature hash -> slot
+		std::unordered_map<uint64_t, uint32_t> contents; // Content hash -> slot
+
+		size_t budget;
+		size_t residentBytes;
+		unsigned int unreferencedTextures;
+		unsigned int evictedTextures;
+		unsigned int deduplicatedTextures;
+		size_t bytesSaved;
+		uint64_t releaseCounter;
+
+		TextureCacheData() : pool(), signatures(), contents(), budget(STDGL_TEXTURE_BUDGET), residentBytes(0), unreferencedTextures(0), evictedTextures(0), deduplicatedTextures(0), bytesSaved(0), releaseCounter(0) {}
+	};
 
-		GLint compileResult = GL_FALSE;
-		GLint infoLoglength;
+	static TextureCacheData g_textureCache;
 
-		STDGL_LOG_TRACE_F("Compiling shader: {}", shaderSource);
+	// Storage is always RGBA8 with a full mip chain, see allocateTexture
+	size_t estimateTextureBytes(int width, int height) {
+		return (size_t)width * height * 4 * 4 / 3;
+	}
 
-		const char* shaderSourcePointer = shaderSource;
-		glShaderSource(shader, 1, &shaderSourcePointer, NULL);
-		glCompileShader(shader);
+	uint64_t hashSignature(const std::string& signature) {
+		return hashBytes64(signature.data(), signature.size(), 0);
+	}
 
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &compileResult);
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLoglength);
+	// nullptr if the signature is not cached
+	const TextureRecord* findCachedTexture(const std::string& signature) {
+		TextureCacheData& cache = g_textureCache;
+		auto it = cache.signatures.find(hashSignature(signature));
+		if (it == cache.signatures.end()) {
+			return nullptr;
+		}
 
-		if (infoLoglength > 0) {
-			std::vector<char> shaderErrorMessage((size_t)infoLoglength + 1);
-			glGetShaderInfoLog(shader, infoLoglength, NULL, &shaderErrorMessage[0]);
-			if (compileResult != GL_TRUE) {
-				STDGL_LOG_ERROR_F("Shader Compilation Error: {}", &shaderErrorMessage[0]);
-				return -1;
-			}
+		const TextureRecord& record = cache.pool.slots[it->second].resource;
+		if (std::find(record.signatures.begin(), record.signatures.end(), signature) == record.signatures.end()) {
+			return nullptr; // Hash collision
 		}
-		return shader;
+		return &record;
 	}
 
-
-	// Implementation
-	//// Creation functions
-	bool beginShader(const char* name) {
-		StdGLID id = getIDWithSeed(g_shaderSeed, name);
-		ShaderData& shaderData = g_shaderDataMap[id];
-		if (!shaderData.initialized) {
-			pushID(id);
-			return true;
+	// The hash is not verified against the bytes, callers also compare the decoded dimensions
+	const TextureRecord* findCachedContent(uint64_t contentHash, size_t encodedSize) {
+		if (contentHash == 0) {
+			return nullptr;
 		}
-		return false;
+		auto it = g_textureCache.contents.find(contentHash);
+		if (it == g_textureCache.contents.end()) {
+			return nullptr;
+		}
+		const TextureRecord& record = g_textureCache.pool.slots[it->second].resource;
+		return record.encodedSize == encodedSize ? &record : nullptr;
 	}
 
-	void endShader() {
-		// TODO: Add shader building code (shader compilation and program linkage)
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
+	bool hasImageLayout(const TextureRecord& record, int width, int height, int channels) {
+		return record.texture.width == (unsigned int)width && record.texture.height == (unsigned int)height && record.texture.channels == (unsigned int)channels;
+	}
 
-		// Check if shader was given enough information to compile
-		STDGL_ASSERT(!shaderData.fragmentFilePath.empty());
-		STDGL_ASSERT(!shaderData.vertexFilePath.empty());
-		
-		// Load source files
-		std::string vertexShaderSource = loadTextResource(shaderData.vertexFilePath.c_str());
-		std::string fragmentShaderSource = loadTextResource(shaderData.fragmentFilePath.c_str());
+	Texture acquireCachedTexture(const TextureRecord& record, const std::string& signature, const TextureType& type) {
+		retainTexture(record.texture);
+		Texture texture = record.texture;
+		texture.type = type;
+		texture.sourcePath = signature;
+		return texture;
+	}
 
+	// The same bytes under a new signature, later loads of it hit the signature lookup directly
+	Texture aliasCachedTexture(const TextureRecord& record, const std::string& signature, const TextureType& type) {
+		TextureCacheData& cache = g_textureCache;
+		const uint32_t index = record.texture.handle.index;
+		STDGL_LOG_TRACE_F("Texture {} has the same content as {}", signature, record.texture.sourcePath);
+
+		cache.pool.slots[index].resource.signatures.push_back(signature);
+		cache.signatures[hashSignature(signature)] = index;
+		++cache.deduplicatedTextures;
+		cache.bytesSaved += record.bytes;
+		return acquireCachedTexture(record, signature, type);
+	}
 
-		// Compile source
-		GLuint vertexShaderID = compileShader(vertexShaderSource.c_str(), GL_VERTEX_SHADER);
-		GLuint fragmentShaderID = compileShader(fragmentShaderSource.c_str(), GL_FRAGMENT_SHADER);
+	Texture registerTexture(const Texture& texture, uint64_t contentHash, size_t encodedSize) {
+		TextureCacheData& cache = g_textureCache;
+		const size_t bytes = estimateTextureBytes(texture.width, texture.height);
+		cache.residentBytes += bytes;
 
-		// Create program, attach shaders and link them
-		shaderData.programID = glCreateProgram();
-		glAttachShader(shaderData.programID, vertexShaderID);
-		glAttachShader(shaderData.programID, fragmentShaderID);
+		ResourceHandle handle = cache.pool.create({ texture, { texture.sourcePath }, contentHash, encodedSize, bytes, 0 });
+		TextureRecord& record = cache.pool.slots[handle.index].resource;
+		record.texture.handle = handle;
 
-		// Bind attributes
-		for (auto const& [key, value] : shaderData.attributes) {
-			glBindAttribLocation(shaderData.programID, key, value.c_str());
+		cache.signatures[hashSignature(texture.sourcePath)] = handle.index;
+		if (contentHash != 0) {
+			cache.contents[contentHash] = handle.index;
 		}
+		return record.texture;
+	}
 
-		// Link program and check for errors
-		glLinkProgram(shaderData.programID);
+	void cancelTextureStream(GLuint textureID) {
+		TextureStreamingData& streaming = g_textureStreaming;
+		if (streaming.pending.erase(textureID) == 0) {
+			return;
+		}
+		for (auto it = streaming.jobs.begin(); it != streaming.jobs.end(); ++it) {
+			if (it->textureID == textureID) {
+				stbi_image_free(it->pixels);
+				streaming.jobs.erase(it);
+				break;
+			}
+		}
+	}
 
-		GLint linkResult;
-		GLint infoLogLength;
+	void destroyTexture(ResourceHandle handle) {
+		TextureCacheData& cache = g_textureCache;
+		TextureRecord& record = cache.pool.slots[handle.index].resource;
+		const GLuint textureID = record.texture.textureID;
 
-		glGetProgramiv(shaderData.programID, GL_LINK_STATUS, &linkResult);
-		glGetProgramiv(shaderData.programID, GL_INFO_LOG_LENGTH, &infoLogLength);
-		if (infoLogLength > 0) {
-			std::vector<char> programErrorMessage((size_t)infoLogLength + 1);
-			glGetProgramInfoLog(shaderData.programID, infoLogLength, nullptr, &programErrorMessage[0]);
-			if (linkResult != GL_TRUE) {
-				STDGL_LOG_ERROR_F("Shader link error:\n{}", &programErrorMessage[0]);
-				glDeleteProgram(shaderData.programID);
+		cancelTextureStream(textureID);
+		glDeleteTextures(1, &textureID);
+		forgetTexture(textureID);
+
+		for (const std::string& signature : record.signatures) {
+			auto it = cache.signatures.find(hashSignature(signature));
+			if (it != cache.signatures.end() && it->second == handle.index) {
+				cache.signatures.erase(it);
 			}
 		}
+		auto contentIt = cache.contents.find(record.contentHash);
+		if (contentIt != cache.contents.end() && contentIt->second == handle.index) {
+			cache.contents.erase(contentIt);
+		}
 
-		// Validate and clean
-		glValidateProgram(shaderData.programID);
+		cache.residentBytes -= record.bytes;
+		cache.pool.destroy(handle);
+	}
 
-		glDetachShader(shaderData.programID, vertexShaderID);
-		glDetachShader(shaderData.programID, fragmentShaderID);
+	// Destroys unreferenced textures, least recently released first, until the cache fits the budget
+	void evictTextures() {
+		TextureCacheData& cache = g_textureCache;
+		if (cache.residentBytes <= cache.budget || cache.unreferencedTextures == 0) {
+			return;
+		}
 
-		glDeleteShader(vertexShaderID);
-		glDeleteShader(fragmentShaderID);
+		std::vector<uint32_t> candidates;
+		for (uint32_t i = 0; i < cache.pool.slots.size(); ++i) {
+			if (cache.pool.slots[i].used && cache.pool.slots[i].refCount == 0) {
+				candidates.push_back(i);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [&cache](uint32_t a, uint32_t b) {
+			return cache.pool.slots[a].resource.releaseOrder < cache.pool.slots[b].resource.releaseOrder;
+		});
 
+		for (uint32_t index : candidates) {
+			if (cache.residentBytes <= cache.budget) {
+				break;
+			}
+			STDGL_LOG_DEBUG_F("Evicting texture: {}", cache.pool.slots[index].resource.texture.sourcePath);
+			destroyTexture({ index, cache.pool.slots[index].generation });
+			--cache.unreferencedTextures;
+			++cache.evictedTextures;
+		}
+	}
 
-		STDGL_LOG_DEBUG("Shader program created");
+	void retainTexture(const Texture& texture) {
+		auto* slot = g_textureCache.pool.find(texture.handle);
+		if (slot != nullptr && slot->refCount++ == 0) {
+			--g_textureCache.unreferencedTextures;
+		}
+	}
 
-		shaderData.initialized = true;
-		popID();
+	void releaseTexture(ResourceHandle handle) {
+		TextureCacheData& cache = g_textureCache;
+		auto* slot = cache.pool.find(handle);
+		if (slot == nullptr || slot->refCount == 0) {
+			return;
+		}
+		if (--slot->refCount == 0) {
+			slot->resource.releaseOrder = ++cache.releaseCounter;
+			++cache.unreferencedTextures;
+			evictTextures();
+		}
 	}
 
-	void shaderUseVertexFile(const std::string& path) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		shaderData.vertexFilePath = path;
+	void unloadTexture(Texture& texture) {
+		releaseTexture(texture.handle);
+		texture = Texture();
 	}
 
-	void shaderUseFragmentFile(const std::string& path) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		shaderData.fragmentFilePath = path;
+	bool isTextureLoaded(const Texture& texture) {
+		if (texture.handle.generation == 0) {
+			return texture.textureID != 0;
+		}
+		return g_textureCache.pool.find(texture.handle) != nullptr;
 	}
 
-	void shaderBindAttribute(unsigned int index, const std::string& name) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		
-		shaderData.attributes[index] = name;
+	void setTextureBudget(size_t bytes) {
+		g_textureCache.budget = bytes;
+		evictTextures();
 	}
 
-	//// Use functions
-	bool useShader(const char* name) {
-		StdGLID id = getIDWithSeed(g_shaderSeed, name);
-		pushID(id);
+	TextureCacheStats getTextureCacheStats() {
+		const TextureCacheData& cache = g_textureCache;
+		TextureCacheStats stats;
+		stats.residentBytes = cache.residentBytes;
+		stats.budgetBytes = cache.budget;
+		stats.residentTextures = (unsigned int)(cache.pool.slots.size() - cache.pool.freeSlots.size());
+		stats.unreferencedTextures = cache.unreferencedTextures;
+		stats.evictedTextures = cache.evictedTextures;
+		stats.deduplicatedTextures = cache.deduplicatedTextures;
+		stats.bytesSaved = cache.bytesSaved;
+		return stats;
+	}
 
-		ShaderData& shaderData = g_shaderDataMap[id];
+	void destroyTextureCache() {
+		TextureCacheData& cache = g_textureCache;
+		for (uint32_t i = 0; i < cache.pool.slots.size(); ++i) {
+			if (cache.pool.slots[i].used) {
+				destroyTexture({ i, cache.pool.slots[i].generation });
+			}
+		}
+		g_textureCache = TextureCacheData();
+	}
 
-		if (shaderData.programID == 0) {
+	// Decoded pixels waiting for upload, can be produced on any thread
+	struct ImageData {
+		std::string signature; // Cache key
+		TextureType type;
+		int width, height, channels;
+		GLenum format;
+		unsigned char* pixels; // Owned, released by freeImage
+
+		// Embedded images keep their source bytes (aiTexture layout) for the model cache
+		bool embedded;
+		std::vector<unsigned char> source;
+		unsigned int sourceWidth, sourceHeight;
+
+		uint64_t contentHash; // Of the encoded file or embedded bytes, finds the same image under other signatures
+		size_t encodedSize; // Length of the hashed bytes
+
+		ImageData() : type(TextureType::DIFFUSE), width(0), height(0), channels(0), format(GL_RGBA), pixels(nullptr), embedded(false), sourceWidth(0), sourceHeight(0), contentHash(0), encodedSize(0) {}
+	};
+
+	void freeImage(ImageData& image) {
+		if (image.pixels != nullptr) {
+			stbi_image_free(image.pixels);
+			image.pixels = nullptr;
+		}
+	}
+
+	bool readFileBytes(const std::string& path, std::vector<unsigned char>& bytes) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+		bytes.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read((char*)bytes.data(), (std::streamsize)bytes.size());
+	}
+
+	// Encoded file contents, hashed by the caller
+	bool decodeImageBytes(ImageData& image, const std::vector<unsigned char>& bytes, uint64_t contentHash, const std::string& sourcePath, const TextureType& type) {
+		STDGL_LOG_TRACE_F("Decoding texture from: {}", sourcePath);
+
+		image.signature = sourcePath;
+		image.type = type;
+		image.contentHash = contentHash;
+		image.encodedSize = bytes.size();
+		image.pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &image.width, &image.height, &image.channels, 0);
+		if (image.pixels == nullptr) {
+			STDGL_LOG_ERROR_F("Failed to load texture: {}", sourcePath);
 			return false;
 		}
 
-		glUseProgram(shaderData.programID);
+		image.format = channelsToFormat(image.channels);
 		return true;
 	}
 
-	void stopShader() {
-		glUseProgram(0);
-		popID();
+	bool decodeImageFile(ImageData& image, const std::string& sourcePath, const TextureType& type) {
+		std::vector<unsigned char> bytes;
+		if (!readFileBytes(sourcePath, bytes)) {
+			STDGL_LOG_ERROR_F("Failed to load texture: {}", sourcePath);
+			return false;
+		}
+		return decodeImageBytes(image, bytes, hashBytes64(bytes.data(), bytes.size(), 0), sourcePath, type);
 	}
 
-	void shaderLoadInt(const char* name, int value) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniform1i(glGetUniformLocation(shaderData.programID, name), value);
+	size_t getEmbeddedImageSize(unsigned int sourceWidth, unsigned int sourceHeight) {
+		return sourceHeight == 0 ? sourceWidth : (size_t)sourceWidth * sourceHeight * sizeof(aiTexel);
 	}
 
-	void shaderLoadFloat(const char* name, float value) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniform1f(glGetUniformLocation(shaderData.programID, name), value);
-	}
+	// Source follows the aiTexture layout:
+	// if sourceHeight == 0 the data is a compressed file (png, jpg, ...) of sourceWidth bytes
+	// else data is sourceWidth*sourceHeight aiTexels, ordered BGRA
+	bool decodeEmbeddedImage(ImageData& image, const unsigned char* source, unsigned int sourceWidth, unsigned int sourceHeight, const TextureType& type, const std::string& signature) {
+		STDGL_LOG_TRACE_F("Decoding embedded texture: {}", signature);
 
-	void shaderLoadVec2(const char* name, glm::vec2 value) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniform2f(glGetUniformLocation(shaderData.programID, name), value.x, value.y);
-	}
+		image.signature = signature;
+		image.type = type;
+		image.embedded = true;
+		image.sourceWidth = sourceWidth;
+		image.sourceHeight = sourceHeight;
 
-	void shaderLoadVec3(const char* name, glm::vec3 value) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniform3f(glGetUniformLocation(shaderData.programID, name), value.x, value.y, value.z);
-	}
+		// Compressed images hash like the same file on disk, raw texels include their dimensions
+		const uint64_t layout = sourceHeight == 0 ? 0 : ((uint64_t)sourceWidth << 32 | sourceHeight);
+		image.encodedSize = getEmbeddedImageSize(sourceWidth, sourceHeight);
+		image.contentHash = hashBytes64(source, image.encodedSize, layout);
 
-	void shaderLoadVec4(const char* name, glm::vec4 value) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniform4f(glGetUniformLocation(shaderData.programID, name), value.x, value.y, value.z, value.w);
+		if (sourceHeight == 0) {
+			STDGL_LOG_TRACE("Texture is compressed");
+			image.pixels = stbi_load_from_memory(source, (int)sourceWidth, &image.width, &image.height, &image.channels, 0);
+			if (image.pixels == nullptr) {
+				STDGL_LOG_ERROR_F("Failed to decode embedded texture: {}", signature);
+				return false;
+			}
+			image.format = channelsToFormat(image.channels);
+		}
+		else {
+			STDGL_LOG_TRACE("Texture is not compressed");
+			const size_t dataSize = getEmbeddedImageSize(sourceWidth, sourceHeight);
+			image.pixels = (unsigned char*)std::malloc(dataSize); // Released through stbi_image_free (free)
+			std::memcpy(image.pixels, source, dataSize);
+			image.width = (int)sourceWidth;
+			image.height = (int)sourceHeight;
+			image.channels = 4;
+			image.format = channelsToFormat(image.channels, true);
+		}
+
+		STDGL_LOG_TRACE_F("Channels: {}", image.channels);
+		return true;
 	}
 
-	void shaderLoadMat4(const char* name, glm::mat4 value) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniformMatrix4fv(glGetUniformLocation(shaderData.programID, name), 1, GL_FALSE, glm::value_ptr(value));
+	// Uploads and caches the image, must run on the GL thread. Frees the pixels.
+	Texture uploadImage(ImageData& image) {
+		if (const TextureRecord* record = findCachedTexture(image.signature)) {
+			STDGL_LOG_TRACE_F("Returning cached texture: {}", image.signature);
+			freeImage(image);
+			return acquireCachedTexture(*record, image.signature, image.type);
+		}
+
+		const TextureRecord* record = findCachedContent(image.contentHash, image.encodedSize);
+		if (record != nullptr && hasImageLayout(*record, image.width, image.height, image.channels)) {
+			freeImage(image);
+			return aliasCachedTexture(*record, image.signature, image.type);
+		}
+
+		GLuint textureID = g_textureStreaming.enabled
+			? streamTexture(image.pixels, image.width, image.height, image.channels, image.format)
+			: loadTextureInternal(image.pixels, image.width, image.height, image.channels, image.format);
+		freeImage(image);
+
+		Texture texture = registerTexture(Texture{ textureID, image.type, (unsigned int)image.width, (unsigned int)image.height, (unsigned int)image.channels, image.format, image.signature, {} }, image.contentHash, image.encodedSize);
+		evictTextures();
+		return texture;
 	}
 
+	Texture loadTexture(const std::string& sourcePath, const TextureType& type) {
+		STDGL_CPU_ZONE("loadTexture");
 
-	void shaderLoadCamera(const Camera& camera) {
-		StdGLID id = getID("");
-		ShaderData& shaderData = g_shaderDataMap[id];
-		glUniformMatrix4fv(glGetUniformLocation(shaderData.programID, "projection"), 1, GL_FALSE, glm::value_ptr(camera.projection));
-		glUniformMatrix4fv(glGetUniformLocation(shaderData.programID, "view"), 1, GL_FALSE, glm::value_ptr(camera.getMatrix()));
+		if (const TextureRecord* record = findCachedTexture(sourcePath)) {
+			STDGL_LOG_TRACE_F("Returning cached texture: {}", sourcePath);
+			return acquireCachedTexture(*record, sourcePath, type);
+		}
+		STDGL_LOG_TRACE_F("Loading texture from: {}", sourcePath);
+
+		// The file bytes are hashed before decoding, a copy under another path skips the decode.
+		// Only the header is parsed to check the dimensions match like uploadImage does
+		std::vector<unsigned char> bytes;
+		const uint64_t contentHash = readFileBytes(sourcePath, bytes) ? hashBytes64(bytes.data(), bytes.size(), 0) : 0;
+		if (const TextureRecord* record = findCachedContent(contentHash, bytes.size())) {
+			int width = 0, height = 0, channels = 0;
+			if (stbi_info_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels) && hasImageLayout(*record, width, height, channels)) {
+				return aliasCachedTexture(*record, sourcePath, type);
+			}
+		}
+
+		ImageData image;
+		decodeImageBytes(image, bytes, contentHash, sourcePath, type);
+		return uploadImage(image);
 	}
 
 
 	//---------------------------------------------------------------
-	// [SECTION] Framebuffer
+	// [SECTION] Mesh
 	//---------------------------------------------------------------
 
-	struct FramebufferAttachment {
-		GLuint textureID;
-		GLuint textureInternalFormat;
-		GLuint textureFormat;
-		GLuint textureDataType;
-		GLenum textureMinFilter;
-		GLenum textureMagFilter;
+	// Owned by the caller, mesh buffers are released by unloadMesh
+	GLuint createVAO() {
+		GLuint vao;
+		glGenVertexArrays(1, &vao);
+		return vao;
+	}
 
-		GLuint targetAttachment;
+	GLuint createVBO() {
+		GLuint vbo;
+		glGenBuffers(1, &vbo);
+		return vbo;
+	}
 
-		FramebufferAttachment(GLuint textureID, GLuint textureInternalFormat, GLuint textureFormat, GLuint textureDataType, GLenum textureMinFilter, GLuint textureMagFilter, GLuint targetAttachment)
-			: textureID(textureID), textureInternalFormat(textureInternalFormat), textureFormat(textureFormat), textureDataType(textureDataType), textureMinFilter(textureMinFilter), textureMagFilter(textureMagFilter), targetAttachment(targetAttachment) {}
+	//// Lifetime
+	struct MeshRecord {
+		GLuint vao, vbo, ebo; // Owned unless shared
+		bool shared;
+		unsigned int formatKey; // Arena of a shared mesh
+		GLsizeiptr vertexOffset, vertexCount; // Arena ranges, vertices in elements and indices in bytes
+		GLsizeiptr indexOffset, indexSize;
+		std::vector<ResourceHandle> textures; // References held by the mesh
 	};
 
-	struct FramebufferData {
-		int width, height;
+	static ResourcePool<MeshRecord> g_meshPool;
 
-		GLuint framebufferID;
+	// Issues the handle of a new mesh and takes a reference to each of its textures
+	void registerMesh(Mesh& mesh, GLsizeiptr indexOffset, GLsizeiptr indexSize) {
+		MeshRecord record{ mesh.vao, mesh.vbo, mesh.ebo, mesh.shared, mesh.format.getKey(), mesh.baseVertex, mesh.vertexCount, indexOffset, indexSize, {} };
+		record.textures.reserve(mesh.textures.size());
+		for (const Texture& texture : mesh.textures) {
+			retainTexture(texture);
+			record.textures.push_back(texture.handle);
+		}
+		mesh.handle = g_meshPool.create(std::move(record));
+	}
 
-		bool hasUpdated = false;
-		std::unordered_map<FramebufferAttachmentType, std::unordered_map<unsigned int, FramebufferAttachment>> attachments;
+	bool isMeshLoaded(const Mesh& mesh) {
+		if (mesh.handle.generation == 0) {
+			return mesh.vao != 0;
+		}
+		return g_meshPool.find(mesh.handle) != nullptr;
+	}
 
-		FramebufferData() : width(0), height(0), framebufferID(0) {}
+	//// Instancing
+	struct InstanceBufferData {
+		GLuint bufferID;
+		GLsizeiptr capacity; // In bytes
+
+		InstanceBufferData() : bufferID(0), capacity(0) {}
 	};
 
-	typedef std::map<StdGLID, FramebufferData> FramebufferDataMap;
-	static FramebufferDataMap g_framebufferDataMap;
+	static InstanceBufferData g_instanceBuffer;
 
-	void initializeFramebuffer(FramebufferData& framebufferData) {
-		glGenFramebuffers(1, &framebufferData.framebufferID);
-		glBindFramebuffer(GL_FRAMEBUFFER, framebufferData.framebufferID);
+	GLuint getInstanceBuffer() {
+		if (g_instanceBuffer.bufferID == 0) {
+			g_instanceBuffer.bufferID = createVBO();
 
-		std::vector<GLenum> buffers;
-		bool hasDepth = false;
+			// Non-instanced draws read instance 0, keep it an identity transform
+			const glm::mat4 identity(1.0f);
+			g_instanceBuffer.capacity = sizeof(glm::mat4);
+			glBindBuffer(GL_ARRAY_BUFFER, g_instanceBuffer.bufferID);
+			glBufferData(GL_ARRAY_BUFFER, g_instanceBuffer.capacity, glm::value_ptr(identity), GL_STREAM_DRAW);
+		}
+		return g_instanceBuffer.bufferID;
+	}
 
-		for (auto& [type, typeAttachments] : framebufferData.attachments) {
-			for (auto& [index, attachment] : typeAttachments) {
-				// attachment.textureID = createTexture();
-				glBindTexture(GL_TEXTURE_2D, attachment.textureID);
-				glTexImage2D(GL_TEXTURE_2D, 0, attachment.textureInternalFormat, framebufferData.width, framebufferData.height, 0, attachment.textureFormat, attachment.textureDataType, nullptr);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, attachment.textureMinFilter);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, attachment.textureMagFilter);
-				glBindTexture(GL_TEXTURE_2D, 0);
-				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.targetAttachment, GL_TEXTURE_2D, attachment.textureID, 0);
-				
-				if (type == FramebufferAttachmentType::COLOR || type == FramebufferAttachmentType::COLOR_RED_INT) {
-					buffers.push_back(attachment.targetAttachment);
-				}
-				else if (type == FramebufferAttachmentType::DEPTH) {
-					hasDepth = true;
-				}
+	// Slot 0 stays the identity of non-instanced draws, instances start at slot 1 (draw with baseInstance 1)
+	void uploadInstanceTransforms(const glm::mat4* transforms, size_t count) {
+		const GLsizeiptr size = (GLsizeiptr)((count + 1) * sizeof(glm::mat4));
+
+		glBindBuffer(GL_ARRAY_BUFFER, getInstanceBuffer());
+		if (size > g_instanceBuffer.capacity) {
+			while (g_instanceBuffer.capacity < size) {
+				g_instanceBuffer.capacity *= 2;
+			}
+		}
+
+		// Orphan the previous storage so the driver does not wait on pending draws
+		const glm::mat4 identity(1.0f);
+		glBufferData(GL_ARRAY_BUFFER, g_instanceBuffer.capacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(identity));
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::mat4), size - sizeof(glm::mat4), transforms);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	//// Vertex formats
+	GLsizei getAttributeSize(VertexAttributeFormat format, int components) {
+		switch (format) {
+			case VertexAttributeFormat::FLOAT:          return components * 4;
+			case VertexAttributeFormat::HALF_FLOAT:     return components * 2;
+			case VertexAttributeFormat::SNORM16:        return 8; // Padded to 4 components
+			case VertexAttributeFormat::UNORM16:        return components * 2;
+			case VertexAttributeFormat::UNORM8:         return 4;
+			case VertexAttributeFormat::INT_2_10_10_10: return 4;
+			default:                                    return 0;
+		}
+	}
+
+	GLsizei VertexFormat::getStride() const {
+		return getAttributeSize(position, 3) + getAttributeSize(normal, 3) + getAttributeSize(textureCoordinate, 2) + getAttributeSize(tangent, 4) + getAttributeSize(color, 4);
+	}
+
+	unsigned int VertexFormat::getKey() const {
+		return (unsigned int)position | ((unsigned int)normal << 4) | ((unsigned int)textureCoordinate << 8) | ((unsigned int)tangent << 12) | ((unsigned int)color << 16);
+	}
+
+	VertexFormat VertexFormat::compressed() {
+		VertexFormat format;
+		format.position = VertexAttributeFormat::SNORM16;
+		format.normal = VertexAttributeFormat::INT_2_10_10_10;
+		format.textureCoordinate = VertexAttributeFormat::HALF_FLOAT;
+		return format;
+	}
+
+	// Writes components floats in the given format, returns the bytes written
+	size_t encodeAttribute(unsigned char* destination, VertexAttributeFormat format, const float* values, int components) {
+		switch (format) {
+			case VertexAttributeFormat::FLOAT:
+				std::memcpy(destination, values, components * sizeof(float));
+				return components * sizeof(float);
+			case VertexAttributeFormat::HALF_FLOAT:
+				for (int i = 0; i < components; ++i) {
+					uint16_t value = glm::packHalf1x16(values[i]);
+					std::memcpy(destination + i * 2, &value, 2);
+				}
+				return components * 2;
+			case VertexAttributeFormat::SNORM16: {
+				uint16_t packed[4] = {};
+				for (int i = 0; i < components && i < 4; ++i) {
+					packed[i] = glm::packSnorm1x16(values[i]);
+				}
+				std::memcpy(destination, packed, sizeof(packed));
+				return sizeof(packed);
+			}
+			case VertexAttributeFormat::UNORM16:
+				for (int i = 0; i < components; ++i) {
+					uint16_t value = glm::packUnorm1x16(values[i]);
+					std::memcpy(destination + i * 2, &value, 2);
+				}
+				return components * 2;
+			case VertexAttributeFormat::UNORM8: {
+				uint32_t value = glm::packUnorm4x8(glm::vec4(values[0], components > 1 ? values[1] : 0.0f, components > 2 ? values[2] : 0.0f, components > 3 ? values[3] : 1.0f));
+				std::memcpy(destination, &value, 4);
+				return 4;
+			}
+			case VertexAttributeFormat::INT_2_10_10_10: {
+				uint32_t value = glm::packSnorm3x10_1x2(glm::vec4(values[0], values[1], values[2], components > 3 ? values[3] : 0.0f));
+				std::memcpy(destination, &value, 4);
+				return 4;
+			}
+			default:
+				return 0;
+		}
+	}
+
+	// Box SNORM16 positions are quantized to, meshes quantized to the same box share their dequantization
+	struct QuantizationBox {
+		glm::vec3 minimum, maximum;
+	};
+
+	// Interleaves the vertices in the given format, SNORM16 positions are stored relative to box (the vertex bounds when null)
+	std::vector<unsigned char> encodeVertices(const Vertex* vertices, size_t vertexCount, const VertexFormat& format, const QuantizationBox* box, glm::vec3& positionScale, glm::vec3& positionOffset) {
+		positionScale = glm::vec3(1.0f);
+		positionOffset = glm::vec3(0.0f);
+
+		if (format.position == VertexAttributeFormat::SNORM16 && (vertexCount > 0 || box != nullptr)) {
+			glm::vec3 minimum, maximum;
+			if (box != nullptr) {
+				minimum = box->minimum;
+				maximum = box->maximum;
+			}
+			else {
+				minimum = maximum = vertices[0].position;
+				for (size_t i = 0; i < vertexCount; ++i) {
+					minimum = glm::min(minimum, vertices[i].position);
+					maximum = glm::max(maximum, vertices[i].position);
+				}
+			}
+			positionOffset = (minimum + maximum) * 0.5f;
+			positionScale = glm::max((maximum - minimum) * 0.5f, glm::vec3(1e-8f));
+		}
+
+	#if !STDGL_VERTEX_TANGENT_COLOR
+		// Not stored on the CPU, formats that keep the attributes get the defaults
+		const glm::vec4 tangent(1.0f, 0.0f, 0.0f, 1.0f);
+		const glm::vec4 color(1.0f);
+	#endif
+
+		const GLsizei stride = format.getStride();
+		std::vector<unsigned char> data(vertexCount * stride);
+
+		for (size_t i = 0; i < vertexCount; ++i) {
+			const Vertex& vertex = vertices[i];
+			unsigned char* destination = data.data() + i * stride;
+
+			glm::vec3 position = (vertex.position - positionOffset) / positionScale;
+			destination += encodeAttribute(destination, format.position, &position.x, 3);
+			destination += encodeAttribute(destination, format.normal, &vertex.normal.x, 3);
+			destination += encodeAttribute(destination, format.textureCoordinate, &vertex.textureCoordinate.x, 2);
+		#if STDGL_VERTEX_TANGENT_COLOR
+			destination += encodeAttribute(destination, format.tangent, &vertex.tangent.x, 4);
+			destination += encodeAttribute(destination, format.color, &vertex.color.x, 4);
+		#else
+			destination += encodeAttribute(destination, format.tangent, &tangent.x, 4);
+			destination += encodeAttribute(destination, format.color, &color.x, 4);
+		#endif
+		}
+		return data;
+	}
+
+	// Sets one attribute pointer, returns the offset of the next attribute
+	GLsizei setupVertexAttribute(GLuint attribute, VertexAttributeFormat format, int components, GLsizei stride, GLsizei offset) {
+		if (format == VertexAttributeFormat::NONE) {
+			glDisableVertexAttribArray(attribute);
+			return offset;
+		}
+
+		glEnableVertexAttribArray(attribute);
+		switch (format) {
+			case VertexAttributeFormat::FLOAT:          glVertexAttribPointer(attribute, components, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)offset); break;
+			case VertexAttributeFormat::HALF_FLOAT:     glVertexAttribPointer(attribute, components, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(size_t)offset); break;
+			case VertexAttributeFormat::SNORM16:        glVertexAttribPointer(attribute, components, GL_SHORT, GL_TRUE, stride, (void*)(size_t)offset); break;
+			case VertexAttributeFormat::UNORM16:        glVertexAttribPointer(attribute, components, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(size_t)offset); break;
+			case VertexAttributeFormat::UNORM8:         glVertexAttribPointer(attribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)offset); break;
+			case VertexAttributeFormat::INT_2_10_10_10: glVertexAttribPointer(attribute, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)offset); break;
+			default: break;
+		}
+		return offset + getAttributeSize(format, components);
+	}
+
+	// Expects the target VAO and its vertex buffer to be bound
+	void setupVertexAttributes(const VertexFormat& format) {
+		const GLsizei stride = format.getStride();
+
+		GLsizei offset = 0;
+		offset = setupVertexAttribute(0, format.position, 3, stride, offset); // Position
+		offset = setupVertexAttribute(1, format.normal, 3, stride, offset); // Normal
+		offset = setupVertexAttribute(2, format.textureCoordinate, 2, stride, offset); // Texture coordinate
+		offset = setupVertexAttribute(TANGENT_ATTRIBUTE, format.tangent, 4, stride, offset);
+		offset = setupVertexAttribute(COLOR_ATTRIBUTE, format.color, 4, stride, offset);
+
+		// Instance transform, one column per attribute
+		glBindBuffer(GL_ARRAY_BUFFER, getInstanceBuffer());
+		for (GLuint column = 0; column < 4; ++column) {
+			GLuint attribute = INSTANCE_TRANSFORM_ATTRIBUTE + column;
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+			glVertexAttribDivisor(attribute, 1);
+		}
+	}
+
+	void computeBounds(const Vertex* vertices, size_t vertexCount, glm::vec3& minimum, glm::vec3& maximum) {
+		if (vertexCount == 0) {
+			minimum = maximum = glm::vec3(0.0f);
+			return;
+		}
+
+		minimum = vertices[0].position;
+		maximum = vertices[0].position;
+		for (size_t i = 0; i < vertexCount; ++i) {
+			minimum = glm::min(minimum, vertices[i].position);
+			maximum = glm::max(maximum, vertices[i].position);
+		}
+	}
+
+	float computeRadius(const Vertex* vertices, size_t vertexCount, const glm::vec3& center) {
+		float radiusSquared = 0.0f;
+		for (size_t i = 0; i < vertexCount; ++i) {
+			glm::vec3 offset = vertices[i].position - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		return std::sqrt(radiusSquared);
+	}
+
+	static GeometryResidency g_geometryResidency = GeometryResidency::KEEP_CPU_COPY;
+
+	void setGeometryResidency(GeometryResidency residency) {
+		g_geometryResidency = residency;
+	}
+
+	GeometryResidency getGeometryResidency() {
+		return g_geometryResidency;
+	}
+
+	GLsizeiptr getIndexTypeSize(GLenum indexType) {
+		switch (indexType) {
+		case GL_UNSIGNED_BYTE: return 1;
+		case GL_UNSIGNED_SHORT: return 2;
+		default: return 4;
+		}
+	}
+
+	// Smallest index type that can address every referenced vertex
+	GLenum chooseIndexType(const unsigned int* indices, size_t indexCount) {
+		unsigned int maximum = 0;
+		for (size_t i = 0; i < indexCount; ++i) {
+			maximum = std::max(maximum, indices[i]);
+		}
+		if (STDGL_BYTE_INDICES && maximum <= 0xFF) {
+			return GL_UNSIGNED_BYTE;
+		}
+		return maximum <= 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	}
+
+	// Narrows the indices to indexType, 32-bit indices are returned without a copy
+	const void* encodeIndices(const unsigned int* indices, size_t indexCount, GLenum indexType, std::vector<unsigned char>& storage) {
+		if (indexType == GL_UNSIGNED_INT) {
+			return indices;
+		}
+
+		storage.resize(indexCount * getIndexTypeSize(indexType));
+		if (indexType == GL_UNSIGNED_SHORT) {
+			uint16_t* narrowed = (uint16_t*)storage.data();
+			for (size_t i = 0; i < indexCount; ++i) {
+				narrowed[i] = (uint16_t)indices[i];
+			}
+		}
+		else {
+			for (size_t i = 0; i < indexCount; ++i) {
+				storage[i] = (unsigned char)indices[i];
+			}
+		}
+		return storage.data();
+	}
+
+	// Fields shared by every upload path, buffers and index ranges are set by the caller
+	Mesh makeMesh(MeshType type, GLenum mode, const Vertex* vertices, size_t vertexCount, const std::vector<Texture>& textures, const VertexFormat& format, const glm::vec3& positionScale, const glm::vec3& positionOffset) {
+		Mesh mesh = {};
+		mesh.textures = textures;
+		mesh.type = type;
+		computeBounds(vertices, vertexCount, mesh.boundsMin, mesh.boundsMax);
+		mesh.center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+		mesh.radius = computeRadius(vertices, vertexCount, mesh.center);
+		mesh.mode = mode;
+		mesh.vertexCount = (GLsizei)vertexCount;
+		mesh.indexType = GL_UNSIGNED_INT;
+		mesh.format = format;
+		mesh.positionScale = positionScale;
+		mesh.positionOffset = positionOffset;
+		return mesh;
+	}
+
+	// Uploads without keeping CPU copies, the loadMesh variants attach them per the residency policy
+	Mesh uploadArrayMesh(GLenum mode, const Vertex* vertices, size_t vertexCount, const std::vector<Texture>& textures, const VertexFormat& format) {
+		GLuint vao = createVAO();
+		GLuint vbo = createVBO();
+
+		glm::vec3 positionScale, positionOffset;
+		std::vector<unsigned char> vertexData = encodeVertices(vertices, vertexCount, format, nullptr, positionScale, positionOffset);
+
+		bindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+
+		setupVertexAttributes(format);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		bindVertexArray(0);
+		Mesh mesh = makeMesh(MeshType::ArrayMesh, mode, vertices, vertexCount, textures, format, positionScale, positionOffset);
+		mesh.vao = vao;
+		mesh.vbo = vbo;
+		registerMesh(mesh, 0, 0);
+		return mesh;
+	}
+
+	Mesh uploadElementMesh(GLenum mode, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const std::vector<Texture>& textures, const VertexFormat& format, const QuantizationBox* box = nullptr) {
+		GLuint vao = createVAO();
+		GLuint vbo = createVBO();
+		GLuint ebo = createVBO();
+
+		glm::vec3 positionScale, positionOffset;
+		std::vector<unsigned char> vertexData = encodeVertices(vertices, vertexCount, format, box, positionScale, positionOffset);
+
+		const GLenum indexType = chooseIndexType(indices, indexCount);
+		std::vector<unsigned char> indexStorage;
+		const void* indexData = encodeIndices(indices, indexCount, indexType, indexStorage);
+
+		bindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * getIndexTypeSize(indexType), indexData, GL_STATIC_DRAW);
+
+		setupVertexAttributes(format);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		bindVertexArray(0);
+		Mesh mesh = makeMesh(MeshType::ElementMesh, mode, vertices, vertexCount, textures, format, positionScale, positionOffset);
+		mesh.vao = vao;
+		mesh.vbo = vbo;
+		mesh.ebo = ebo;
+		mesh.indiceCount = (GLsizei)indexCount;
+		mesh.indexType = indexType;
+		registerMesh(mesh, 0, 0);
+		return mesh;
+	}
+
+	void keepGeometry(Mesh& mesh, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+		if (g_geometryResidency == GeometryResidency::KEEP_CPU_COPY) {
+			mesh.vertices.assign(vertices, vertices + vertexCount);
+			mesh.indices.assign(indices, indices + indexCount);
+		}
+	}
+
+	void keepGeometry(Mesh& mesh, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices) {
+		if (g_geometryResidency == GeometryResidency::KEEP_CPU_COPY) {
+			mesh.vertices = std::move(vertices);
+			mesh.indices = std::move(indices);
+		}
+		else {
+			// Release the memory even if the caller holds on to the moved-from vectors
+			std::vector<Vertex>().swap(vertices);
+			std::vector<unsigned int>().swap(indices);
+		}
+	}
+
+	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<Texture>& textures, const VertexFormat& format) {
+		Mesh mesh = uploadArrayMesh(mode, vertices.data(), vertices.size(), textures, format);
+		keepGeometry(mesh, vertices.data(), vertices.size(), nullptr, 0);
+		return mesh;
+	}
+
+	Mesh loadMesh(GLenum mode, std::vector<Vertex>&& vertices, const std::vector<Texture>& textures, const VertexFormat& format) {
+		Mesh mesh = uploadArrayMesh(mode, vertices.data(), vertices.size(), textures, format);
+		keepGeometry(mesh, std::move(vertices), {});
+		return mesh;
+	}
+
+	Mesh loadMeshFromMemory(GLenum mode, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const std::vector<Texture>& textures, const VertexFormat& format) {
+		Mesh mesh = uploadElementMesh(mode, vertices, vertexCount, indices, indexCount, textures, format);
+		keepGeometry(mesh, vertices, vertexCount, indices, indexCount);
+		return mesh;
+	}
+
+	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures, const VertexFormat& format) {
+		return loadMeshFromMemory(mode, vertices.data(), vertices.size(), indices.data(), indices.size(), textures, format);
+	}
+
+	Mesh loadMesh(GLenum mode, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, const std::vector<Texture>& textures, const VertexFormat& format) {
+		Mesh mesh = uploadElementMesh(mode, vertices.data(), vertices.size(), indices.data(), indices.size(), textures, format);
+		keepGeometry(mesh, std::move(vertices), std::move(indices));
+		return mesh;
+	}
+
+	//// Mesh optimization
+	VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+		std::vector<unsigned int> cacheTime(vertexCount, 0); // Time of the last miss, 0 if never loaded
+		std::vector<bool> referenced(vertexCount, false);
+		unsigned int time = STDGL_VERTEX_CACHE_SIZE + 1;
+		size_t misses = 0;
+		size_t uniqueVertices = 0;
+
+		for (unsigned int index : indices) {
+			// FIFO: an entry stays cached for the next STDGL_VERTEX_CACHE_SIZE misses
+			if (cacheTime[index] == 0 || time - cacheTime[index] > STDGL_VERTEX_CACHE_SIZE) {
+				cacheTime[index] = time++;
+				++misses;
+			}
+			if (!referenced[index]) {
+				referenced[index] = true;
+				++uniqueVertices;
+			}
+		}
+
+		size_t triangleCount = indices.size() / 3;
+		return {
+			triangleCount > 0 ? (float)misses / triangleCount : 0.0f,
+			uniqueVertices > 0 ? (float)misses / uniqueVertices : 0.0f
+		};
+	}
+
+	// Merges bitwise identical vertices
+	void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		struct VertexHash {
+			size_t operator()(const Vertex& vertex) const { return hashStr((const char*)&vertex, sizeof(Vertex), 0); }
+		};
+		struct VertexEqual {
+			bool operator()(const Vertex& a, const Vertex& b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+		};
+
+		std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> lookup;
+		lookup.reserve(vertices.size());
+
+		std::vector<Vertex> welded;
+		std::vector<unsigned int> remap(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			auto [it, inserted] = lookup.emplace(vertices[i], (unsigned int)welded.size());
+			if (inserted) {
+				welded.push_back(vertices[i]);
+			}
+			remap[i] = it->second;
+		}
+
+		for (unsigned int& index : indices) {
+			index = remap[index];
+		}
+		vertices.swap(welded);
+	}
+
+	// Forsyth's linear-speed vertex cache optimization
+	void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+		const int cacheSize = STDGL_VERTEX_CACHE_SIZE;
+		const size_t triangleCount = indices.size() / 3;
+
+		auto vertexScore = [cacheSize](int cachePosition, unsigned int remainingTriangles) {
+			if (remainingTriangles == 0) {
+				return -1.0f;
+			}
+			float score = 0.0f;
+			if (cachePosition >= 0) {
+				// The last triangle's vertices get a fixed score so it is not simply repeated
+				score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), 1.5f);
+			}
+			return score + 2.0f / std::sqrt((float)remainingTriangles); // Valence boost, finish off lonely vertices
+		};
+
+		// Triangle adjacency per vertex
+		std::vector<unsigned int> triangleOffsets(vertexCount + 1, 0);
+		for (unsigned int index : indices) {
+			++triangleOffsets[index + 1];
+		}
+		for (size_t i = 0; i < vertexCount; ++i) {
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+		std::vector<unsigned int> remainingTriangles(vertexCount);
+		std::vector<unsigned int> adjacency(indices.size());
+		{
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i) {
+				adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+			}
+		}
+		for (size_t i = 0; i < vertexCount; ++i) {
+			remainingTriangles[i] = triangleOffsets[i + 1] - triangleOffsets[i];
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i) {
+			vertexScores[i] = vertexScore(-1, remainingTriangles[i]);
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+
+		std::vector<unsigned int> cache, newCache;
+		cache.reserve(cacheSize + 3);
+		newCache.reserve(cacheSize + 3);
+
+		size_t scanCursor = 0;
+		size_t bestTriangle = 0;
+
+		for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+			if (bestTriangle >= triangleCount || emitted[bestTriangle]) {
+				// Nothing adjacent to the cache, continue with the next unemitted triangle
+				while (scanCursor < triangleCount && emitted[scanCursor]) {
+					++scanCursor;
+				}
+				bestTriangle = scanCursor;
+			}
+
+			const size_t triangle = bestTriangle;
+			emitted[triangle] = true;
+
+			newCache.clear();
+			for (int corner = 0; corner < 3; ++corner) {
+				unsigned int vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				newCache.push_back(vertex);
+
+				// Remove the triangle from the vertex adjacency
+				unsigned int* begin = adjacency.data() + triangleOffsets[vertex];
+				unsigned int* end = begin + remainingTriangles[vertex];
+				*std::find(begin, end, (unsigned int)triangle) = *(end - 1);
+				--remainingTriangles[vertex];
+			}
+			for (unsigned int vertex : cache) {
+				if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+					newCache.push_back(vertex);
+				}
+			}
+
+			// Rescore the vertices that changed cache position, their triangles are scored while picking the next one
+			for (size_t i = 0; i < newCache.size(); ++i) {
+				unsigned int vertex = newCache[i];
+				cachePosition[vertex] = i < (size_t)cacheSize ? (int)i : -1;
+				vertexScores[vertex] = vertexScore(cachePosition[vertex], remainingTriangles[vertex]);
+			}
+
+			float bestScore = -1.0f;
+			bestTriangle = triangleCount;
+			for (size_t i = 0; i < newCache.size() && i < (size_t)cacheSize; ++i) {
+				unsigned int vertex = newCache[i];
+				for (unsigned int j = 0; j < remainingTriangles[vertex]; ++j) {
+					unsigned int adjacent = adjacency[triangleOffsets[vertex] + j];
+					float score = vertexScores[indices[adjacent * 3]] + vertexScores[indices[adjacent * 3 + 1]] + vertexScores[indices[adjacent * 3 + 2]];
+					if (score > bestScore) {
+						bestScore = score;
+						bestTriangle = adjacent;
+					}
+				}
+			}
+
+			if (newCache.size() > (size_t)cacheSize) {
+				newCache.resize(cacheSize);
+			}
+			cache.swap(newCache);
+		}
+
+		indices.swap(result);
+	}
+
+	// Splits the cache optimized order into clusters where the cache efficiency drops, then draws
+	// clusters facing away from the mesh center first, they are most likely to occlude the rest
+	void optimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float threshold = 1.05f) {
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+
+		const float targetAcmr = analyzeVertexCache(indices, vertices.size()).acmr * threshold;
+
+		// Cluster boundaries, simulating the same FIFO cache
+		std::vector<size_t> clusters = { 0 };
+		{
+			std::vector<unsigned int> cacheTime(vertices.size(), 0);
+			unsigned int time = STDGL_VERTEX_CACHE_SIZE + 1;
+			size_t clusterMisses = 0;
+			for (size_t t = 0; t < triangleCount; ++t) {
+				unsigned int triangleMisses = 0;
+				for (int corner = 0; corner < 3; ++corner) {
+					unsigned int index = indices[t * 3 + corner];
+					if (cacheTime[index] == 0 || time - cacheTime[index] > STDGL_VERTEX_CACHE_SIZE) {
+						cacheTime[index] = time++;
+						++triangleMisses;
+					}
+				}
+				clusterMisses += triangleMisses;
+
+				// A full miss restarts the cache, split there while the cluster still meets the target (Tipsify)
+				size_t clusterSize = t + 1 - clusters.back();
+				if (triangleMisses == 3 && clusterSize > 1 && (float)(clusterMisses - 3) / (clusterSize - 1) <= targetAcmr) {
+					clusters.push_back(t);
+					clusterMisses = 3;
+				}
+			}
+		}
+
+		glm::vec3 meshCenter(0.0f);
+		for (const Vertex& vertex : vertices) {
+			meshCenter += vertex.position;
+		}
+		meshCenter /= (float)std::max<size_t>(vertices.size(), 1);
+
+		std::vector<std::pair<float, size_t>> order; // Sort key, cluster
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			size_t begin = clusters[c];
+			size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			// Area weighted centroid and normal
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = begin; t < end; ++t) {
+				const glm::vec3& a = vertices[indices[t * 3]].position;
+				const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+				const glm::vec3& c = vertices[indices[t * 3 + 2]].position;
+				glm::vec3 triangleNormal = glm::cross(b - a, c - a);
+				float triangleArea = glm::length(triangleNormal);
+				centroid += (a + b + c) * (triangleArea / 3.0f);
+				normal += triangleNormal;
+				area += triangleArea;
+			}
+
+			float key = 0.0f;
+			float normalLength = glm::length(normal);
+			if (area > 0.0f && normalLength > 0.0f) {
+				key = glm::dot(centroid / area - meshCenter, normal / normalLength);
+			}
+			order.emplace_back(key, c);
+		}
+		std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		std::vector<unsigned int> result;
+		result.reserve(indices.size());
+		for (const auto& [key, c] : order) {
+			size_t begin = clusters[c];
+			size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+			result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+		}
+		indices.swap(result);
+	}
+
+	// Renumbers vertices in order of first use, unreferenced vertices are dropped
+	void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		const unsigned int unused = 0xFFFFFFFF;
+		std::vector<unsigned int> remap(vertices.size(), unused);
+		std::vector<Vertex> ordered;
+		ordered.reserve(vertices.size());
+
+		for (unsigned int& index : indices) {
+			if (remap[index] == unused) {
+				remap[index] = (unsigned int)ordered.size();
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(ordered);
+	}
+
+	MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+		STDGL_CPU_ZONE("optimizeMesh");
+
+		MeshOptimizationStats stats;
+		stats.verticesBefore = vertices.size();
+		stats.before = analyzeVertexCache(indices, vertices.size());
+
+		if (indices.size() % 3 == 0 && !indices.empty()) {
+			weldVertices(vertices, indices);
+			optimizeVertexCache(indices, vertices.size());
+			optimizeOverdraw(vertices, indices);
+			optimizeVertexFetch(vertices, indices);
+		}
+
+		stats.verticesAfter = vertices.size();
+		stats.after = analyzeVertexCache(indices, vertices.size());
+		return stats;
+	}
+
+	//// Mesh simplification
+	// Symmetric 4x4 plane quadric, weighted by triangle area
+	struct Quadric {
+		double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+		double weight;
+
+		Quadric() : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0), weight(0) {}
+
+		void addPlane(const glm::vec3& planeNormal, double distance, double planeWeight) {
+			const double normal[3] = { planeNormal.x, planeNormal.y, planeNormal.z };
+			a00 += planeWeight * normal[0] * normal[0]; a01 += planeWeight * normal[0] * normal[1]; a02 += planeWeight * normal[0] * normal[2]; a03 += planeWeight * normal[0] * distance;
+			a11 += planeWeight * normal[1] * normal[1]; a12 += planeWeight * normal[1] * normal[2]; a13 += planeWeight * normal[1] * distance;
+			a22 += planeWeight * normal[2] * normal[2]; a23 += planeWeight * normal[2] * distance;
+			a33 += planeWeight * distance * distance;
+			weight += planeWeight;
+		}
+
+		void add(const Quadric& other) {
+			a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+			a11 += other.a11; a12 += other.a12; a13 += other.a13;
+			a22 += other.a22; a23 += other.a23;
+			a33 += other.a33;
+			weight += other.weight;
+		}
+
+		// Mean squared distance of the point to the accumulated planes
+		double evaluate(const glm::vec3& point) const {
+			const double x = point.x, y = point.y, z = point.z;
+			double error = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+				+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+				+ a22 * z * z + 2 * a23 * z
+				+ a33;
+			return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct EdgeCollapse {
+		unsigned int from, to;
+		float cost;
+	};
+
+	// Moving from onto to must not flip or degenerate the other triangles around from
+	bool isCollapseValid(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& triangles, const std::vector<unsigned int>& adjacencyOffsets, const std::vector<unsigned int>& adjacency, unsigned int from, unsigned int to) {
+		const glm::vec3& target = vertices[to].position;
+		for (unsigned int i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i) {
+			const unsigned int* triangle = &triangles[adjacency[i] * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+				continue; // Removed by the collapse
+			}
+
+			glm::vec3 corners[3] = { vertices[triangle[0]].position, vertices[triangle[1]].position, vertices[triangle[2]].position };
+			glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			for (int corner = 0; corner < 3; ++corner) {
+				if (triangle[corner] == from) {
+					corners[corner] = target;
+				}
+			}
+			glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+
+			if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// group[i] is the first vertex with the position of vertex i
+	void groupVerticesByPosition(const std::vector<Vertex>& vertices, std::vector<unsigned int>& group) {
+		struct PositionHash {
+			size_t operator()(const glm::vec3& position) const { return hashStr((const char*)&position, sizeof(glm::vec3), 0); }
+		};
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> lookup;
+		lookup.reserve(vertices.size());
+		group.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			group[i] = lookup.emplace(vertices[i].position, (unsigned int)i).first->second;
+		}
+	}
+
+	// sourceTriangles receives the input triangle each output triangle was collapsed from
+	std::vector<unsigned int> simplifyMeshInternal(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float* error, std::vector<unsigned int>* sourceTriangles) {
+		STDGL_CPU_ZONE("simplifyMesh");
+
+		const size_t vertexCount = vertices.size();
+		std::vector<unsigned int> triangles = indices;
+		float maximumError = 0.0f;
+
+		std::vector<unsigned int> origins;
+		if (sourceTriangles != nullptr) {
+			origins.resize(indices.size() / 3);
+			for (size_t i = 0; i < origins.size(); ++i) {
+				origins[i] = (unsigned int)i;
+			}
+		}
+
+		if (indices.size() % 3 != 0 || indices.size() <= targetIndexCount) {
+			if (error != nullptr) {
+				*error = 0.0f;
+			}
+			if (sourceTriangles != nullptr) {
+				*sourceTriangles = std::move(origins);
+			}
+			return triangles;
+		}
+
+		// Vertices sharing a position are one corner of the surface (UV or normal seams)
+		std::vector<unsigned int> positionGroup;
+		groupVerticesByPosition(vertices, positionGroup);
+
+		// Seams and open borders stay in place, moving them would tear the surface
+		std::vector<bool> locked(vertexCount, false);
+		{
+			// Only referenced vertices make a seam
+			std::vector<bool> referenced(vertexCount, false);
+			for (unsigned int index : triangles) {
+				referenced[index] = true;
+			}
+			std::vector<unsigned int> groupSize(vertexCount, 0);
+			for (size_t i = 0; i < vertexCount; ++i) {
+				groupSize[positionGroup[i]] += referenced[i] ? 1 : 0;
+			}
+
+			std::unordered_map<uint64_t, int> edgeUses; // Undirected group edge -> triangle count
+			for (size_t i = 0; i < triangles.size(); i += 3) {
+				for (int corner = 0; corner < 3; ++corner) {
+					uint64_t a = positionGroup[triangles[i + corner]];
+					uint64_t b = positionGroup[triangles[i + (corner + 1) % 3]];
+					++edgeUses[std::min(a, b) << 32 | std::max(a, b)];
+				}
+			}
+
+			std::vector<bool> borderGroup(vertexCount, false);
+			for (const auto& [edge, uses] : edgeUses) {
+				if (uses == 1) {
+					borderGroup[edge >> 32] = true;
+					borderGroup[edge & 0xFFFFFFFF] = true;
+				}
+			}
+			for (size_t i = 0; i < vertexCount; ++i) {
+				locked[i] = groupSize[positionGroup[i]] > 1 || borderGroup[positionGroup[i]];
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			const glm::vec3& a = vertices[triangles[i]].position;
+			const glm::vec3& b = vertices[triangles[i + 1]].position;
+			const glm::vec3& c = vertices[triangles[i + 2]].position;
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+			if (area <= 0.0f) {
+				continue;
+			}
+			normal /= area;
+			for (int corner = 0; corner < 3; ++corner) {
+				quadrics[triangles[i + corner]].addPlane(normal, -glm::dot(normal, a), area * 0.5f);
+			}
+		}
+
+		std::vector<unsigned int> adjacencyOffsets, adjacency;
+		std::vector<EdgeCollapse> collapses;
+		std::vector<unsigned int> remap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+
+		// Each pass collapses the cheapest independent edges, then the triangle list is rebuilt
+		while (triangles.size() > targetIndexCount) {
+			adjacencyOffsets.assign(vertexCount + 1, 0);
+			for (unsigned int index : triangles) {
+				++adjacencyOffsets[index + 1];
+			}
+			for (size_t i = 0; i < vertexCount; ++i) {
+				adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+			}
+			adjacency.resize(triangles.size());
+			{
+				std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < triangles.size(); ++i) {
+					adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3);
+				}
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < triangles.size(); i += 3) {
+				for (int corner = 0; corner < 3; ++corner) {
+					unsigned int a = triangles[i + corner];
+					unsigned int b = triangles[i + (corner + 1) % 3];
+					if (!locked[a]) {
+						Quadric quadric = quadrics[a];
+						quadric.add(quadrics[b]);
+						collapses.push_back({ a, b, (float)quadric.evaluate(vertices[b].position) });
+					}
+					if (!locked[b]) {
+						Quadric quadric = quadrics[a];
+						quadric.add(quadrics[b]);
+						collapses.push_back({ b, a, (float)quadric.evaluate(vertices[a].position) });
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b) { return a.cost < b.cost; });
+
+			for (size_t i = 0; i < vertexCount; ++i) {
+				remap[i] = (unsigned int)i;
+			}
+			touched.assign(vertexCount, false);
+
+			size_t triangleCount = triangles.size() / 3;
+			const size_t targetTriangles = targetIndexCount / 3;
+			size_t applied = 0;
+			for (const EdgeCollapse& collapse : collapses) {
+				if (triangleCount <= targetTriangles) {
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]
+					|| !isCollapseValid(vertices, triangles, adjacencyOffsets, adjacency, collapse.from, collapse.to)) {
+					continue;
+				}
+
+				// Lock the neighbourhood for the rest of the pass so the validity checks stay exact
+				for (unsigned int j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; ++j) {
+					const unsigned int* triangle = &triangles[adjacency[j] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+						--triangleCount;
+					}
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				maximumError = std::max(maximumError, collapse.cost);
+				++applied;
+			}
+
+			if (applied == 0) {
+				break; // Everything left is locked or would fold over
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < triangles.size(); i += 3) {
+				unsigned int a = remap[triangles[i]], b = remap[triangles[i + 1]], c = remap[triangles[i + 2]];
+				if (a != b && b != c && c != a) {
+					if (!origins.empty()) {
+						origins[write / 3] = origins[i / 3];
+					}
+					triangles[write++] = a;
+					triangles[write++] = b;
+					triangles[write++] = c;
+				}
+			}
+			triangles.resize(write);
+			if (!origins.empty()) {
+				origins.resize(write / 3);
+			}
+		}
+
+		if (error != nullptr) {
+			*error = std::sqrt(maximumError);
+		}
+		if (sourceTriangles != nullptr) {
+			*sourceTriangles = std::move(origins);
+		}
+		return triangles;
+	}
+
+	std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float* error) {
+		return simplifyMeshInternal(vertices, indices, targetIndexCount, error, nullptr);
+	}
+
+	//// Shared geometry arena
+	#ifndef STDGL_ARENA_INITIAL_VERTICES
+	#define STDGL_ARENA_INITIAL_VERTICES (1 << 18)
+	#endif
+
+	#ifndef STDGL_ARENA_INITIAL_INDICES
+	#define STDGL_ARENA_INITIAL_INDICES (1 << 20)
+	#endif
+
+	struct ArenaRange {
+		GLsizeiptr offset;
+		GLsizeiptr size;
+	};
+
+	// Large vertex and index buffers meshes are suballocated from, sharing one vao.
+	// One arena per vertex format. Vertices are counted in elements, indices in bytes since
+	// every mesh stores its own index type, aligned to the index size. Ranges of unloaded
+	// meshes are reused first fit, new ones are appended.
+	struct GeometryArenaData {
+		GLuint vao;
+		GLuint vbo;
+		GLuint ebo;
+
+		VertexFormat format;
+		GLsizeiptr vertexCapacity;
+		GLsizeiptr indexCapacity;
+		GLsizeiptr vertexCount; // End of the used vertices
+		GLsizeiptr indexSize; // End of the used indices
+
+		std::vector<ArenaRange> freeVertices, freeIndices; // Below the ends, sorted by offset and merged
+
+		GeometryArenaData() : vao(0), vbo(0), ebo(0), format(), vertexCapacity(0), indexCapacity(0), vertexCount(0), indexSize(0), freeVertices(), freeIndices() {}
+	};
+
+	static std::unordered_map<unsigned int, GeometryArenaData> g_geometryArenas; // Vertex format key -> arena
+
+	// Replaces buffer with a larger one, keeping the first usedSize bytes
+	GLuint growArenaBuffer(GLuint buffer, GLsizeiptr usedSize, GLsizeiptr newSize) {
+		GLuint newBuffer;
+		glGenBuffers(1, &newBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+
+		if (buffer != 0) {
+			if (usedSize > 0) {
+				glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedSize);
+				glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return newBuffer;
+	}
+
+	GLsizeiptr alignArenaIndices(const GeometryArenaData& arena, GLenum indexType) {
+		const GLsizeiptr alignment = getIndexTypeSize(indexType);
+		return (arena.indexSize + alignment - 1) / alignment * alignment;
+	}
+
+	GeometryArenaData& reserveGeometryArena(const VertexFormat& format, GLsizeiptr vertexCount, GLsizeiptr indexCount, GLenum indexType) {
+		GeometryArenaData& arena = g_geometryArenas[format.getKey()];
+		const GLsizeiptr vertexSize = format.getStride();
+
+		if (arena.vao == 0) {
+			arena.vao = createVAO();
+			arena.format = format;
+		}
+
+		bool rebind = false;
+		if (arena.vertexCount + vertexCount > arena.vertexCapacity) {
+			GLsizeiptr capacity = arena.vertexCapacity > 0 ? arena.vertexCapacity : STDGL_ARENA_INITIAL_VERTICES;
+			while (capacity < arena.vertexCount + vertexCount) {
+				capacity *= 2;
+			}
+			arena.vbo = growArenaBuffer(arena.vbo, arena.vertexCount * vertexSize, capacity * vertexSize);
+			arena.vertexCapacity = capacity;
+			rebind = true;
+			STDGL_LOG_DEBUG_F("Geometry arena vertex capacity: {}", capacity);
+		}
+
+		const GLsizeiptr indexSize = alignArenaIndices(arena, indexType) + indexCount * getIndexTypeSize(indexType);
+		if (indexSize > arena.indexCapacity) {
+			GLsizeiptr capacity = arena.indexCapacity > 0 ? arena.indexCapacity : STDGL_ARENA_INITIAL_INDICES * (GLsizeiptr)sizeof(unsigned int);
+			while (capacity < indexSize) {
+				capacity *= 2;
+			}
+			arena.ebo = growArenaBuffer(arena.ebo, arena.indexSize, capacity);
+			arena.indexCapacity = capacity;
+			rebind = true;
+			STDGL_LOG_DEBUG_F("Geometry arena index capacity: {} bytes", capacity);
+		}
+
+		// Point the shared vao at the (new) buffers
+		if (rebind) {
+			bindVertexArray(arena.vao);
+			glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.ebo);
+			setupVertexAttributes(arena.format);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			bindVertexArray(0);
+		}
+		return arena;
+	}
+
+	// First fit, the start is aligned inside the range and the remainders stay free
+	bool allocateArenaRange(std::vector<ArenaRange>& ranges, GLsizeiptr size, GLsizeiptr alignment, GLsizeiptr& offset) {
+		if (size == 0) {
+			return false;
+		}
+
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			const GLsizeiptr rangeEnd = ranges[i].offset + ranges[i].size;
+			const GLsizeiptr begin = (ranges[i].offset + alignment - 1) / alignment * alignment;
+			const GLsizeiptr end = begin + size;
+			if (end > rangeEnd) {
+				continue;
+			}
+
+			if (begin > ranges[i].offset) {
+				ranges[i].size = begin - ranges[i].offset;
+				if (end < rangeEnd) {
+					ranges.insert(ranges.begin() + i + 1, { end, rangeEnd - end });
+				}
+			}
+			else if (end < rangeEnd) {
+				ranges[i] = { end, rangeEnd - end };
+			}
+			else {
+				ranges.erase(ranges.begin() + i);
+			}
+			offset = begin;
+			return true;
+		}
+		return false;
+	}
+
+	// Merges with the neighbouring free ranges, a range reaching the end lowers the end instead
+	void releaseArenaRange(std::vector<ArenaRange>& ranges, GLsizeiptr offset, GLsizeiptr size, GLsizeiptr& end) {
+		if (size == 0) {
+			return;
+		}
+
+		auto it = std::lower_bound(ranges.begin(), ranges.end(), offset, [](const ArenaRange& range, GLsizeiptr value) { return range.offset < value; });
+		it = ranges.insert(it, { offset, size });
+		if (it + 1 != ranges.end() && it->offset + it->size == (it + 1)->offset) {
+			it->size += (it + 1)->size;
+			ranges.erase(it + 1);
+		}
+		if (it != ranges.begin() && (it - 1)->offset + (it - 1)->size == it->offset) {
+			(it - 1)->size += it->size;
+			it = ranges.erase(it) - 1;
+		}
+		if (it->offset + it->size == end) {
+			end = it->offset;
+			ranges.erase(it);
+		}
+	}
+
+	// Indices are relative to baseVertex, so the index type only depends on the mesh itself
+	Mesh uploadSharedMesh(GLenum mode, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const std::vector<Texture>& textures, const VertexFormat& format, const QuantizationBox* box = nullptr) {
+		const GLenum indexType = chooseIndexType(indices, indexCount);
+		const GLsizeiptr indexTypeSize = getIndexTypeSize(indexType);
+
+		GeometryArenaData& arena = g_geometryArenas[format.getKey()];
+		GLsizeiptr vertexOffset = 0, indexOffset = 0;
+		const bool reuseVertices = allocateArenaRange(arena.freeVertices, (GLsizeiptr)vertexCount, 1, vertexOffset);
+		const bool reuseIndices = allocateArenaRange(arena.freeIndices, (GLsizeiptr)indexCount * indexTypeSize, indexTypeSize, indexOffset);
+		reserveGeometryArena(format, reuseVertices ? 0 : vertexCount, reuseIndices ? 0 : indexCount, indexType);
+
+		if (!reuseVertices) {
+			vertexOffset = arena.vertexCount;
+			arena.vertexCount += vertexCount;
+		}
+		if (!reuseIndices) {
+			const GLsizeiptr previousSize = arena.indexSize;
+			indexOffset = alignArenaIndices(arena, indexType);
+			arena.indexSize = indexOffset + indexCount * indexTypeSize;
+			releaseArenaRange(arena.freeIndices, previousSize, indexOffset - previousSize, arena.indexSize); // Alignment padding
+		}
+
+		GLint baseVertex = (GLint)vertexOffset;
+		GLuint firstIndex = (GLuint)(indexOffset / indexTypeSize); // In units of the index type
+
+		std::vector<unsigned char> indexStorage;
+		const void* indexData = encodeIndices(indices, indexCount, indexType, indexStorage);
+
+		glm::vec3 positionScale, positionOffset;
+		std::vector<unsigned char> vertexData = encodeVertices(vertices, vertexCount, format, box, positionScale, positionOffset);
+
+		glBindBuffer(GL_ARRAY_BUFFER, arena.vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, baseVertex * (GLsizeiptr)format.getStride(), vertexData.size(), vertexData.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// Bind through the copy target, binding GL_ELEMENT_ARRAY_BUFFER would need the vao bound
+		glBindBuffer(GL_COPY_WRITE_BUFFER, arena.ebo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexCount * indexTypeSize, indexData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		Mesh mesh = makeMesh(MeshType::ElementMesh, mode, vertices, vertexCount, textures, format, positionScale, positionOffset);
+		mesh.vao = arena.vao;
+		mesh.indiceCount = (GLsizei)indexCount;
+		mesh.indexType = indexType;
+		mesh.shared = true;
+		mesh.baseVertex = baseVertex;
+		mesh.firstIndex = firstIndex;
+		registerMesh(mesh, indexOffset, indexCount * indexTypeSize);
+		return mesh;
+	}
+
+	Mesh loadSharedMeshFromMemory(GLenum mode, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const std::vector<Texture>& textures, const VertexFormat& format) {
+		Mesh mesh = uploadSharedMesh(mode, vertices, vertexCount, indices, indexCount, textures, format);
+		keepGeometry(mesh, vertices, vertexCount, indices, indexCount);
+		return mesh;
+	}
+
+	// Deleted objects are unbound by GL, their names may be reused
+	void forgetVertexArray(GLuint vertexArray) {
+		if (g_stdglContext != nullptr && g_stdglContext->stateCache.vertexArray == vertexArray) {
+			g_stdglContext->stateCache.vertexArray = 0;
+		}
+	}
+
+	void destroyMesh(ResourceHandle handle) {
+		MeshRecord& record = g_meshPool.slots[handle.index].resource;
+		if (record.shared) {
+			auto it = g_geometryArenas.find(record.formatKey);
+			if (it != g_geometryArenas.end()) {
+				GeometryArenaData& arena = it->second;
+				releaseArenaRange(arena.freeVertices, record.vertexOffset, record.vertexCount, arena.vertexCount);
+				releaseArenaRange(arena.freeIndices, record.indexOffset, record.indexSize, arena.indexSize);
+			}
+		}
+		else {
+			forgetVertexArray(record.vao);
+			glDeleteVertexArrays(1, &record.vao);
+			glDeleteBuffers(1, &record.vbo);
+			if (record.ebo != 0) {
+				glDeleteBuffers(1, &record.ebo);
+			}
+		}
+
+		for (ResourceHandle texture : record.textures) {
+			releaseTexture(texture);
+		}
+		g_meshPool.destroy(handle);
+	}
+
+	void retainMesh(const Mesh& mesh) {
+		auto* slot = g_meshPool.find(mesh.handle);
+		if (slot != nullptr) {
+			++slot->refCount;
+		}
+	}
+
+	void releaseMesh(ResourceHandle handle) {
+		auto* slot = g_meshPool.find(handle);
+		if (slot != nullptr && --slot->refCount == 0) {
+			destroyMesh(handle);
+		}
+	}
+
+	void unloadMesh(Mesh& mesh) {
+		releaseMesh(mesh.handle);
+		mesh = Mesh();
+	}
+
+	// Also releases the shared geometry arenas
+	void destroyMeshes() {
+		for (uint32_t i = 0; i < g_meshPool.slots.size(); ++i) {
+			if (g_meshPool.slots[i].used) {
+				destroyMesh({ i, g_meshPool.slots[i].generation });
+			}
+		}
+		g_meshPool = ResourcePool<MeshRecord>();
+
+		for (auto& [key, arena] : g_geometryArenas) {
+			forgetVertexArray(arena.vao);
+			glDeleteVertexArrays(1, &arena.vao);
+			glDeleteBuffers(1, &arena.vbo);
+			glDeleteBuffers(1, &arena.ebo);
+		}
+		g_geometryArenas.clear();
+	}
+
+	Mesh loadSharedMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures, const VertexFormat& format) {
+		return loadSharedMeshFromMemory(mode, vertices.data(), vertices.size(), indices.data(), indices.size(), textures, format);
+	}
+
+	Mesh loadSharedMesh(GLenum mode, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, const std::vector<Texture>& textures, const VertexFormat& format) {
+		Mesh mesh = uploadSharedMesh(mode, vertices.data(), vertices.size(), indices.data(), indices.size(), textures, format);
+		keepGeometry(mesh, std::move(vertices), std::move(indices));
+		return mesh;
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Camera utlities
+	//---------------------------------------------------------------
+
+	glm::mat4 Camera::getMatrix() const {
+		return glm::inverse(glm::translate(glm::mat4(1.0f), position) * glm::toMat4(glm::quat(rotation)));
+	}
+
+	glm::mat4 Camera::generateProjection() const {
+		RenderContext& renderContext = g_stdglContext->renderContext;
+		return glm::perspectiveFov(fov, (float)renderContext.width, (float)renderContext.height, zNear, zFar);
+	}
+
+	//---------------------------------------------------------------
+	// [SECTION] Shader
+	//---------------------------------------------------------------
+
+	// Internal
+	struct ShaderData {
+		bool initialized;
+
+		GLuint programID;
+
+		std::map<unsigned int, std::string> attributes;
+		std::unordered_map<StdGLID, GLint> uniformLocations; // Uniform name hash -> location, built after linking, misses added on lookup
+		bool hasCameraBlock; // Program reads the camera from the per-frame uniform buffer
+		bool compiling; // Queued by a parallel compile, see pollShaderCompiles
+		GLint positionScaleLocation, positionOffsetLocation; // Dequantization of SNORM16 positions, -1 if unused
+
+		// TODO: convert to sources
+		std::string vertexFilePath;
+		std::string fragmentFilePath;
+		
+		ShaderData() : initialized(false), programID(0), hasCameraBlock(false), compiling(false), positionScaleLocation(-1), positionOffsetLocation(-1), vertexFilePath(""), fragmentFilePath("") {}
+	};
+
+	typedef std::map<StdGLID, ShaderData> ShaderDataMap;
+	static ShaderDataMap g_shaderDataMap;
+	static int g_shaderSeed = 0;
+
+	// Shader bound by useShader, avoids the id hash and map lookup on every uniform upload
+	static ShaderData* g_activeShaderData = nullptr;
+
+	StdGLID hashUniformName(const char* name) {
+		return hashStr(name, 0, 0);
+	}
+
+	void cacheUniformLocations(ShaderData& shaderData) {
+		shaderData.uniformLocations.clear();
+
+		GLint uniformCount = 0;
+		GLint maxNameLength = 0;
+		glGetProgramiv(shaderData.programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+		glGetProgramiv(shaderData.programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+		std::vector<char> nameBuffer((size_t)maxNameLength + 1);
+		for (GLint i = 0; i < uniformCount; ++i) {
+			GLsizei nameLength = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(shaderData.programID, (GLuint)i, maxNameLength, &nameLength, &size, &type, nameBuffer.data());
+
+			// Uniforms inside blocks have no location
+			GLint location = glGetUniformLocation(shaderData.programID, nameBuffer.data());
+			if (location < 0) {
+				continue;
+			}
+
+			StdGLID id = hashUniformName(nameBuffer.data());
+			if (shaderData.uniformLocations.count(id) != 0) {
+				STDGL_LOG_ERROR_F("Uniform name hash collision: {}", nameBuffer.data());
+			}
+			shaderData.uniformLocations[id] = location;
+
+			// Arrays are reported as "name[0]", also register them as "name"
+			if (nameLength > 3 && std::strcmp(nameBuffer.data() + nameLength - 3, "[0]") == 0) {
+				nameBuffer[(size_t)nameLength - 3] = '\0';
+				shaderData.uniformLocations[hashUniformName(nameBuffer.data())] = location;
+			}
+		}
+
+		STDGL_LOG_TRACE_F("Cached {} uniform locations", shaderData.uniformLocations.size());
+	}
+
+	ShaderData& getActiveShaderData() {
+		if (g_activeShaderData != nullptr) {
+			return *g_activeShaderData;
+		}
+		StdGLID id = getID("");
+		return g_shaderDataMap[id];
+	}
+
+	GLint getUniformLocation(ShaderData& shaderData, const char* name) {
+		StdGLID id = hashUniformName(name);
+		auto it = shaderData.uniformLocations.find(id);
+		if (it != shaderData.uniformLocations.end()) {
+			return it->second;
+		}
+		if (shaderData.programID == 0) {
+			return -1;
+		}
+
+		// Array elements ("weights[2]") and struct members are not all reported by glGetActiveUniform,
+		// ask the driver once and remember the answer, -1 included
+		GLint location = glGetUniformLocation(shaderData.programID, name);
+		shaderData.uniformLocations[id] = location;
+		return location;
+	}
+
+
+	// Starts the compile, the status is queried later by checkShaderCompile
+	GLuint compileShader(const char* shaderSource, GLenum shaderType) {
+		GLuint shader = glCreateShader(shaderType);
+
+		STDGL_LOG_TRACE_F("Compiling shader: {}", shaderSource);
+
+		const char* shaderSourcePointer = shaderSource;
+		glShaderSource(shader, 1, &shaderSourcePointer, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	bool checkShaderCompile(GLuint shader) {
+		GLint compileResult = GL_FALSE;
+		GLint infoLoglength;
+
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &compileResult);
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLoglength);
+
+		if (compileResult != GL_TRUE && infoLoglength > 0) {
+			std::vector<char> shaderErrorMessage((size_t)infoLoglength + 1);
+			glGetShaderInfoLog(shader, infoLoglength, NULL, &shaderErrorMessage[0]);
+			STDGL_LOG_ERROR_F("Shader Compilation Error: {}", &shaderErrorMessage[0]);
+		}
+		return compileResult == GL_TRUE;
+	}
+
+	//// Parallel compilation (GL_KHR_parallel_shader_compile)
+	#ifndef GL_COMPLETION_STATUS_KHR
+	#define GL_COMPLETION_STATUS_KHR 0x91B1
+	#endif
+
+	typedef void (APIENTRY* MaxShaderCompilerThreadsProc)(GLuint count);
+
+	struct ParallelCompileData {
+		bool enabled;
+		bool initialized;
+		bool extensionSupported; // Without it completion can not be polled, builds finish on the next poll
+
+		ParallelCompileData() : enabled(false), initialized(false), extensionSupported(false) {}
+	};
+
+	static ParallelCompileData g_parallelCompile;
+
+	bool hasExtension(const char* name) {
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount; ++i) {
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension != nullptr && std::strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void setParallelShaderCompile(bool enabled) {
+		g_parallelCompile.enabled = enabled;
+		if (!enabled || g_parallelCompile.initialized) {
+			return;
+		}
+		g_parallelCompile.initialized = true;
+
+		if (hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile")) {
+			g_parallelCompile.extensionSupported = true;
+
+			// Let the driver pick the thread count
+			MaxShaderCompilerThreadsProc maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)getGLProcAddress("glMaxShaderCompilerThreadsKHR");
+			if (maxShaderCompilerThreads == nullptr) {
+				maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)getGLProcAddress("glMaxShaderCompilerThreadsARB");
+			}
+			if (maxShaderCompilerThreads != nullptr) {
+				maxShaderCompilerThreads(0xFFFFFFFF);
+			}
+		}
+		STDGL_LOG_DEBUG_F("Parallel shader compile, driver support: {}", g_parallelCompile.extensionSupported);
+	}
+
+	// A program being compiled and linked
+	struct ProgramBuild {
+		GLuint programID;
+		GLuint vertexShaderID;
+		GLuint fragmentShaderID;
+	};
+
+	struct PendingProgram {
+		StdGLID id;
+		ProgramBuild build;
+
+		bool saveBinary;
+		uint64_t key;
+		uint64_t sourceLength;
+		std::string cachePath;
+	};
+
+	static std::vector<PendingProgram> g_pendingPrograms;
+
+
+	// Implementation
+	//// Creation functions
+	bool beginShader(const char* name) {
+		StdGLID id = getIDWithSeed(g_shaderSeed, name);
+		ShaderData& shaderData = g_shaderDataMap[id];
+		if (!shaderData.initialized) {
+			pushID(id);
+			return true;
+		}
+		return false;
+	}
+
+	//// Program binary cache
+	constexpr char PROGRAM_CACHE_MAGIC[8] = { 'S', 'T', 'D', 'G', 'L', 'P', 'R', 'G' };
+	constexpr uint32_t PROGRAM_CACHE_VERSION = 2;
+
+	struct ProgramCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t binaryFormat;
+		uint64_t key; // Hash of sources, attributes and driver
+		uint64_t sourceLength; // Guards against key collisions
+		uint32_t binaryLength;
+		uint32_t reserved;
+	};
+
+	bool supportsProgramBinaries() {
+		static int formatCount = -1;
+		if (formatCount < 0) {
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		}
+		return formatCount > 0;
+	}
+
+	// Binaries are only valid for the driver that produced them
+	const std::string& getDriverSignature() {
+		static std::string signature;
+		if (signature.empty()) {
+			for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+				const GLubyte* value = glGetString(name);
+				signature.append(value ? (const char*)value : "").append("\n");
+			}
+		}
+		return signature;
+	}
+
+	// 64-bit and over the full text, hashStr is 32-bit and restarts at every "###"
+	uint64_t computeProgramKey(const ShaderData& shaderData, const std::string& vertexSource, const std::string& fragmentSource) {
+		const std::string& driver = getDriverSignature();
+		uint64_t key = hashBytes64(vertexSource.data(), vertexSource.size(), 0);
+		key = hashBytes64(fragmentSource.data(), fragmentSource.size(), key);
+		for (auto const& [index, name] : shaderData.attributes) {
+			key = hashBytes64(&index, sizeof(index), key);
+			key = hashBytes64(name.data(), name.size(), key);
+		}
+		return hashBytes64(driver.data(), driver.size(), key);
+	}
+
+	std::string getProgramCachePath(const ShaderData& shaderData, uint64_t key) {
+		char name[40];
+		std::snprintf(name, sizeof(name), "%016llx.stdglprogram", (unsigned long long)key);
+
+		// Without a cache directory binaries live next to the vertex shader
+		std::filesystem::path directory = g_cacheDirectory.empty()
+			? std::filesystem::path(shaderData.vertexFilePath).parent_path()
+			: std::filesystem::path(g_cacheDirectory);
+		return (directory / name).string();
+	}
+
+	GLuint loadProgramBinary(const std::string& cachePath, uint64_t key, uint64_t sourceLength) {
+		std::ifstream file(cachePath, std::ios::binary);
+		if (!file.is_open()) {
+			return 0;
+		}
+
+		ProgramCacheHeader header;
+		if (!file.read((char*)&header, sizeof(header))
+			|| std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != PROGRAM_CACHE_VERSION
+			|| header.key != key
+			|| header.sourceLength != sourceLength) {
+			return 0;
+		}
+
+		std::vector<char> binary(header.binaryLength);
+		if (!file.read(binary.data(), binary.size())) {
+			return 0;
+		}
+
+		GLuint programID = glCreateProgram();
+		glProgramBinary(programID, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+		// Drivers reject binaries after updates, fall back to compiling
+		GLint linkResult = GL_FALSE;
+		glGetProgramiv(programID, GL_LINK_STATUS, &linkResult);
+		if (linkResult != GL_TRUE) {
+			STDGL_LOG_DEBUG_F("Program binary rejected by driver: {}", cachePath);
+			glDeleteProgram(programID);
+			std::error_code error;
+			std::filesystem::remove(cachePath, error);
+			return 0;
+		}
+
+		STDGL_LOG_DEBUG_F("Loaded program binary: {}", cachePath);
+		return programID;
+	}
+
+	void saveProgramBinary(const std::string& cachePath, GLuint programID, uint64_t key, uint64_t sourceLength) {
+		GLint binaryLength = 0;
+		glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+		if (binaryLength <= 0) {
+			return;
+		}
+
+		std::vector<char> binary((size_t)binaryLength);
+		GLenum binaryFormat = 0;
+		glGetProgramBinary(programID, binaryLength, nullptr, &binaryFormat, binary.data());
+
+		ProgramCacheHeader header = {};
+		std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+		header.version = PROGRAM_CACHE_VERSION;
+		header.key = key;
+		header.sourceLength = sourceLength;
+		header.binaryFormat = binaryFormat;
+		header.binaryLength = (uint32_t)binaryLength;
+
+		createCacheDirectory();
+		std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+		if (!file.write((const char*)&header, sizeof(header)) || !file.write(binary.data(), binary.size())) {
+			STDGL_LOG_ERROR_F("Failed to write program binary: {}", cachePath);
+			return;
+		}
+		STDGL_LOG_DEBUG_F("Wrote program binary: {}", cachePath);
+	}
+
+	// Issues compile and link without querying any status, so the driver may run them in the background
+	ProgramBuild startProgramBuild(const ShaderData& shaderData, const std::string& vertexShaderSource, const std::string& fragmentShaderSource, bool retrievable) {
+		ProgramBuild build;
+
+		// Compile source
+		build.vertexShaderID = compileShader(vertexShaderSource.c_str(), GL_VERTEX_SHADER);
+		build.fragmentShaderID = compileShader(fragmentShaderSource.c_str(), GL_FRAGMENT_SHADER);
+
+		// Create program, attach shaders and link them
+		build.programID = glCreateProgram();
+		glAttachShader(build.programID, build.vertexShaderID);
+		glAttachShader(build.programID, build.fragmentShaderID);
+
+		// Bind attributes
+		for (auto const& [key, value] : shaderData.attributes) {
+			glBindAttribLocation(build.programID, key, value.c_str());
+		}
+
+		if (retrievable) {
+			glProgramParameteri(build.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		glLinkProgram(build.programID);
+		return build;
+	}
+
+	bool isProgramBuildComplete(const ProgramBuild& build) {
+		if (!g_parallelCompile.extensionSupported) {
+			return true;
+		}
+		GLint complete = GL_FALSE;
+		glGetProgramiv(build.programID, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete == GL_TRUE;
+	}
+
+	// Checks for errors and cleans up, returns the program or 0 on failure
+	GLuint finishProgramBuild(const ProgramBuild& build) {
+		GLint linkResult;
+		GLint infoLogLength;
+
+		glGetProgramiv(build.programID, GL_LINK_STATUS, &linkResult);
+		if (linkResult != GL_TRUE) {
+			checkShaderCompile(build.vertexShaderID);
+			checkShaderCompile(build.fragmentShaderID);
+
+			glGetProgramiv(build.programID, GL_INFO_LOG_LENGTH, &infoLogLength);
+			if (infoLogLength > 0) {
+				std::vector<char> programErrorMessage((size_t)infoLogLength + 1);
+				glGetProgramInfoLog(build.programID, infoLogLength, nullptr, &programErrorMessage[0]);
+				STDGL_LOG_ERROR_F("Shader link error:\n{}", &programErrorMessage[0]);
+			}
+		}
+
+		#ifndef NDEBUG
+		// Validation depends on the current state and stalls, only useful while debugging
+		if (linkResult == GL_TRUE) {
+			glValidateProgram(build.programID);
+		}
+		#endif
+
+		glDetachShader(build.programID, build.vertexShaderID);
+		glDetachShader(build.programID, build.fragmentShaderID);
+
+		glDeleteShader(build.vertexShaderID);
+		glDeleteShader(build.fragmentShaderID);
+
+		if (linkResult != GL_TRUE) {
+			glDeleteProgram(build.programID);
+			return 0;
+		}
+		return build.programID;
+	}
+
+	// Resolve all uniform locations and block bindings once
+	void introspectProgram(ShaderData& shaderData) {
+		cacheUniformLocations(shaderData);
+		shaderData.positionScaleLocation = getUniformLocation(shaderData, "positionScale");
+		shaderData.positionOffsetLocation = getUniformLocation(shaderData, "positionOffset");
+
+		GLuint cameraBlockIndex = glGetUniformBlockIndex(shaderData.programID, "CameraData");
+		shaderData.hasCameraBlock = cameraBlockIndex != GL_INVALID_INDEX;
+		if (shaderData.hasCameraBlock) {
+			glUniformBlockBinding(shaderData.programID, cameraBlockIndex, CAMERA_UNIFORM_BINDING);
+		}
+	}
+
+	void endShader() {
+		STDGL_CPU_ZONE("endShader");
+
+		StdGLID id = getID("");
+		ShaderData& shaderData = g_shaderDataMap[id];
+
+		// Check if shader was given enough information to compile
+		STDGL_ASSERT(!shaderData.fragmentFilePath.empty());
+		STDGL_ASSERT(!shaderData.vertexFilePath.empty());
+		
+		// Load source files
+		std::string vertexShaderSource = loadTextResource(shaderData.vertexFilePath.c_str());
+		std::string fragmentShaderSource = loadTextResource(shaderData.fragmentFilePath.c_str());
+
+		// Try the program binary cache before compiling
+		const bool useBinaryCache = supportsProgramBinaries();
+		const uint64_t sourceLength = vertexShaderSource.size() + fragmentShaderSource.size();
+		uint64_t key = 0;
+		std::string cachePath;
+		shaderData.programID = 0;
+
+		if (useBinaryCache) {
+			key = computeProgramKey(shaderData, vertexShaderSource, fragmentShaderSource);
+			cachePath = getProgramCachePath(shaderData, key);
+			shaderData.programID = loadProgramBinary(cachePath, key, sourceLength);
+		}
+
+		if (shaderData.programID == 0) {
+			ProgramBuild build = startProgramBuild(shaderData, vertexShaderSource, fragmentShaderSource, useBinaryCache);
+
+			// Finished by pollShaderCompiles, the program is unusable until then
+			if (g_parallelCompile.enabled) {
+				shaderData.compiling = true;
+				g_pendingPrograms.push_back({ id, build, useBinaryCache, key, sourceLength, cachePath });
+				shaderData.initialized = true;
+				popID();
+				return;
+			}
+
+			shaderData.programID = finishProgramBuild(build);
+			if (shaderData.programID != 0 && useBinaryCache) {
+				saveProgramBinary(cachePath, shaderData.programID, key, sourceLength);
+			}
+		}
+
+		if (shaderData.programID != 0) {
+			introspectProgram(shaderData);
+			STDGL_LOG_DEBUG("Shader program created");
+		}
+
+		shaderData.initialized = true;
+		popID();
+	}
+
+	void pollShaderCompiles() {
+		STDGL_CPU_ZONE("pollShaderCompiles");
+
+		for (size_t i = 0; i < g_pendingPrograms.size();) {
+			PendingProgram& pending = g_pendingPrograms[i];
+			if (!isProgramBuildComplete(pending.build)) {
+				++i;
+				continue;
+			}
+
+			ShaderData& shaderData = g_shaderDataMap[pending.id];
+			shaderData.programID = finishProgramBuild(pending.build);
+			shaderData.compiling = false;
+
+			if (shaderData.programID != 0) {
+				if (pending.saveBinary) {
+					saveProgramBinary(pending.cachePath, shaderData.programID, pending.key, pending.sourceLength);
+				}
+				introspectProgram(shaderData);
+				STDGL_LOG_DEBUG("Shader program created");
+			}
+
+			g_pendingPrograms[i] = std::move(g_pendingPrograms.back());
+			g_pendingPrograms.pop_back();
+		}
+	}
+
+	bool isShaderReady(const char* name) {
+		StdGLID id = getIDWithSeed(g_shaderSeed, name);
+		auto it = g_shaderDataMap.find(id);
+		return it != g_shaderDataMap.end() && !it->second.compiling && it->second.programID != 0;
+	}
+
+	void shaderUseVertexFile(const std::string& path) {
+		StdGLID id = getID("");
+		ShaderData& shaderData = g_shaderDataMap[id];
+		shaderData.vertexFilePath = path;
+	}
+
+	void shaderUseFragmentFile(const std::string& path) {
+		StdGLID id = getID("");
+		ShaderData& shaderData = g_shaderDataMap[id];
+		shaderData.fragmentFilePath = path;
+	}
+
+	void shaderBindAttribute(unsigned int index, const std::string& name) {
+		StdGLID id = getID("");
+		ShaderData& shaderData = g_shaderDataMap[id];
+		
+		shaderData.attributes[index] = name;
+	}
+
+	//// Use functions
+	bool useShader(const char* name) {
+		StdGLID id = getIDWithSeed(g_shaderSeed, name);
+		pushID(id);
+
+		ShaderData& shaderData = g_shaderDataMap[id];
+
+		// Unbind the previous program so draws until the next useShader do not run with it
+		if (shaderData.programID == 0 || shaderData.compiling) {
+			g_activeShaderData = nullptr;
+			bindProgram(0);
+			return false;
+		}
+
+		g_activeShaderData = &shaderData;
+		bindProgram(shaderData.programID);
+		return true;
+	}
+
+	void stopShader() {
+		// The program stays bound, rebinding it next frame is then elided
+		g_activeShaderData = nullptr;
+		popID();
+	}
+
+	GLint getUniformLocation(const char* name) {
+		return getUniformLocation(getActiveShaderData(), name);
+	}
+
+	enum class UniformValueType {
+		INT,
+		FLOAT,
+		VEC2,
+		VEC3,
+		VEC4,
+		MAT4
+	};
+
+	size_t getUniformValueSize(UniformValueType type) {
+		switch (type) {
+			case UniformValueType::VEC2: return sizeof(glm::vec2);
+			case UniformValueType::VEC3: return sizeof(glm::vec3);
+			case UniformValueType::VEC4: return sizeof(glm::vec4);
+			case UniformValueType::MAT4: return sizeof(glm::mat4);
+			default: return 4;
+		}
+	}
+
+	void applyUniformValue(GLint location, UniformValueType type, const void* value) {
+		switch (type) {
+			case UniformValueType::INT:   glUniform1iv(location, 1, (const GLint*)value); break;
+			case UniformValueType::FLOAT: glUniform1fv(location, 1, (const GLfloat*)value); break;
+			case UniformValueType::VEC2:  glUniform2fv(location, 1, (const GLfloat*)value); break;
+			case UniformValueType::VEC3:  glUniform3fv(location, 1, (const GLfloat*)value); break;
+			case UniformValueType::VEC4:  glUniform4fv(location, 1, (const GLfloat*)value); break;
+			case UniformValueType::MAT4:  glUniformMatrix4fv(location, 1, GL_FALSE, (const GLfloat*)value); break;
+		}
+	}
+
+	void recordQueuedUniform(GLint location, UniformValueType type, const void* value);
+
+	// Every uniform load goes through here, queued draws replay the values loaded before they were queued
+	void loadUniformValue(GLint location, UniformValueType type, const void* value) {
+		applyUniformValue(location, type, value);
+		if (g_stdglContext->renderContext.renderMode == RenderMode::QUEUED) {
+			recordQueuedUniform(location, type, value);
+		}
+	}
+
+	void shaderLoadInt(const char* name, int value) {
+		loadUniformValue(getUniformLocation(name), UniformValueType::INT, &value);
+	}
+
+	void shaderLoadFloat(const char* name, float value) {
+		loadUniformValue(getUniformLocation(name), UniformValueType::FLOAT, &value);
+	}
+
+	void shaderLoadVec2(const char* name, glm::vec2 value) {
+		loadUniformValue(getUniformLocation(name), UniformValueType::VEC2, glm::value_ptr(value));
+	}
+
+	void shaderLoadVec3(const char* name, glm::vec3 value) {
+		loadUniformValue(getUniformLocation(name), UniformValueType::VEC3, glm::value_ptr(value));
+	}
+
+	void shaderLoadVec4(const char* name, glm::vec4 value) {
+		loadUniformValue(getUniformLocation(name), UniformValueType::VEC4, glm::value_ptr(value));
+	}
+
+	void shaderLoadMat4(const char* name, glm::mat4 value) {
+		loadUniformValue(getUniformLocation(name), UniformValueType::MAT4, glm::value_ptr(value));
+	}
+
+
+	bool loadCameraBlock(const Camera& camera);
+
+	void shaderLoadCamera(const Camera& camera) {
+		ShaderData& shaderData = getActiveShaderData();
+		const RenderContext& renderContext = g_stdglContext->renderContext;
+		bool isFrameCamera = renderContext.camera.get() == &camera;
+
+		// CameraData shaders have no projection and view uniforms, the block is written instead
+		if (shaderData.hasCameraBlock) {
+			if (!loadCameraBlock(camera)) {
+				STDGL_LOG_ERROR("shaderLoadCamera needs beginRender for shaders using the CameraData block");
+			}
+			return;
+		}
+
+		glm::mat4 view = isFrameCamera ? renderContext.view : camera.getMatrix();
+		loadUniformValue(getUniformLocation(shaderData, "projection"), UniformValueType::MAT4, glm::value_ptr(camera.projection));
+		loadUniformValue(getUniformLocation(shaderData, "view"), UniformValueType::MAT4, glm::value_ptr(view));
+	}
+
+	//// Uniform handles
+	template<> void UniformHandle<int>::load(const int& value) const {
+		loadUniformValue(location, UniformValueType::INT, &value);
+	}
+
+	template<> void UniformHandle<float>::load(const float& value) const {
+		loadUniformValue(location, UniformValueType::FLOAT, &value);
+	}
+
+	template<> void UniformHandle<glm::vec2>::load(const glm::vec2& value) const {
+		loadUniformValue(location, UniformValueType::VEC2, glm::value_ptr(value));
+	}
+
+	template<> void UniformHandle<glm::vec3>::load(const glm::vec3& value) const {
+		loadUniformValue(location, UniformValueType::VEC3, glm::value_ptr(value));
+	}
+
+	template<> void UniformHandle<glm::vec4>::load(const glm::vec4& value) const {
+		loadUniformValue(location, UniformValueType::VEC4, glm::value_ptr(value));
+	}
+
+	template<> void UniformHandle<glm::mat4>::load(const glm::mat4& value) const {
+		loadUniformValue(location, UniformValueType::MAT4, glm::value_ptr(value));
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Framebuffer
+	//---------------------------------------------------------------
+
+	struct FramebufferAttachment {
+		GLuint textureID;
+		GLuint textureInternalFormat;
+		GLuint textureFormat;
+		GLuint textureDataType;
+		GLenum textureMinFilter;
+		GLenum textureMagFilter;
+
+		GLuint targetAttachment;
+
+		FramebufferAttachment(GLuint textureID, GLuint textureInternalFormat, GLuint textureFormat, GLuint textureDataType, GLenum textureMinFilter, GLuint textureMagFilter, GLuint targetAttachment)
+			: textureID(textureID), textureInternalFormat(textureInternalFormat), textureFormat(textureFormat), textureDataType(textureDataType), textureMinFilter(textureMinFilter), textureMagFilter(textureMagFilter), targetAttachment(targetAttachment) {}
+	};
+
+	struct FramebufferData {
+		int width, height;
+
+		GLuint framebufferID;
+
+		bool hasUpdated = false;
+		std::unordered_map<FramebufferAttachmentType, std::unordered_map<unsigned int, FramebufferAttachment>> attachments;
+
+		FramebufferData() : width(0), height(0), framebufferID(0) {}
+	};
+
+	typedef std::map<StdGLID, FramebufferData> FramebufferDataMap;
+	static FramebufferDataMap g_framebufferDataMap;
+
+	void initializeFramebuffer(FramebufferData& framebufferData) {
+		glGenFramebuffers(1, &framebufferData.framebufferID);
+		bindFramebuffer(framebufferData.framebufferID);
+
+		std::vector<GLenum> buffers;
+		bool hasDepth = false;
+
+		for (auto& [type, typeAttachments] : framebufferData.attachments) {
+			for (auto& [index, attachment] : typeAttachments) {
+				// attachment.textureID = createTexture();
+				bindTexture2D(0, attachment.textureID);
+				glTexImage2D(GL_TEXTURE_2D, 0, attachment.textureInternalFormat, framebufferData.width, framebufferData.height, 0, attachment.textureFormat, attachment.textureDataType, nullptr);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, attachment.textureMinFilter);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, attachment.textureMagFilter);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.targetAttachment, GL_TEXTURE_2D, attachment.textureID, 0);
+				
+				if (type == FramebufferAttachmentType::COLOR || type == FramebufferAttachmentType::COLOR_RED_INT) {
+					buffers.push_back(attachment.targetAttachment);
+				}
+				else if (type == FramebufferAttachmentType::DEPTH) {
+					hasDepth = true;
+				}
 			}
 		}
 
@@ -817,341 +3573,3248 @@ namespace stdgl {
 			glDrawBuffers(buffers.size(), buffers.data());
 		}
 		else {
-			glDrawBuffers(buffers.size(), buffers.data());
+			glDrawBuffers(buffers.size(), buffers.data());
+		}
+
+		// Create texture
+		/*
+			// Create depth attachment
+			glGenRenderbuffers(1, &framebufferData.rbo);
+			glBindRenderbuffer(GL_RENDERBUFFER, framebufferData.rbo);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, framebufferData.width, framebufferData.height);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebufferData.rbo);
+
+		framebufferData.depthTextureID = createTexture();
+		glBindTexture(GL_TEXTURE_2D, framebufferData.depthTextureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, framebufferData.width, framebufferData.height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebufferData.depthTextureID, 0);
+
+		if (extraAttachment) {
+			// Create extra texture attchment
+			framebufferData.extraID = createTexture();
+			glBindTexture(GL_TEXTURE_2D, framebufferData.extraID);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, framebufferData.width, framebufferData.height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, framebufferData.extraID, 0);
+
+			GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+			glDrawBuffers(2, buffers);
+		}
+		*/
+
+		// Check completeness
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			STDGL_LOG_ERROR_F("Framebuffer is not complete! Status: {}", status);
+		}
+
+		// Reset
+		framebufferData.hasUpdated = false;
+	}
+
+	void destroyFramebuffer(FramebufferData& framebufferData) {
+		glDeleteFramebuffers(1, &framebufferData.framebufferID);
+		forgetFramebuffer(framebufferData.framebufferID);
+
+		for (const auto& [type, typeAttachments] : framebufferData.attachments) {
+			for (const auto& [index, attachment] : typeAttachments) {
+				glDeleteTextures(1, &attachment.textureID);
+				forgetTexture(attachment.textureID);
+			}
+		}
+
+		framebufferData.attachments.clear();
+		framebufferData.framebufferID = 0;
+	}
+
+	GLuint addAttachment(FramebufferAttachmentType type, unsigned int attachmentIndex) {
+		StdGLID id = getID("");
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+
+		GLuint textureID = createTexture();
+
+		if (type == FramebufferAttachmentType::COLOR) {
+			framebufferData.attachments[type].emplace(attachmentIndex, FramebufferAttachment(textureID, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, GL_LINEAR, GL_LINEAR, GL_COLOR_ATTACHMENT0 + attachmentIndex));
+		}
+		else if (type == FramebufferAttachmentType::DEPTH) {
+			framebufferData.attachments[type].emplace(attachmentIndex, FramebufferAttachment(textureID, GL_DEPTH_COMPONENT32, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, GL_LINEAR, GL_LINEAR, GL_DEPTH_ATTACHMENT));
+		}
+		else if (type == FramebufferAttachmentType::COLOR_RED_INT) {
+			framebufferData.attachments[type].emplace(attachmentIndex, FramebufferAttachment(textureID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, GL_NEAREST, GL_NEAREST, GL_COLOR_ATTACHMENT0 + attachmentIndex));
+		}
+
+		framebufferData.hasUpdated = true;
+		return textureID;
+	}
+
+	bool beginFramebuffer(const char* name, int width, int height, bool extraAttachment) {
+		StdGLID id = getID(name);
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+
+		if (width == 0 || height == 0) {
+			width = g_stdglContext->renderContext.width;
+			height = g_stdglContext->renderContext.height;
+		}
+
+		if (width == 0 || height == 0) return false;
+
+		if (framebufferData.width != width || framebufferData.height != height || framebufferData.hasUpdated) {
+			framebufferData.hasUpdated = false;
+			framebufferData.width = width;
+			framebufferData.height = height;
+			// Destroy existing framebuffer
+			if (framebufferData.framebufferID != 0) {
+				destroyFramebuffer(framebufferData);
+			}
+			pushID(id);
+			return true;
+		}
+		return false;
+	}
+
+	void buildFramebuffer() {
+		StdGLID id = getID("");
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+		initializeFramebuffer(framebufferData);
+		framebufferData.hasUpdated = false;
+	}
+
+	void endFramebuffer() {
+		bindFramebuffer(0);
+		popID();
+	}
+
+	bool useFramebuffer(const char* name) {
+		StdGLID id = getID(name);
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+
+		if (framebufferData.framebufferID == 0) {
+			return false;
+		}
+
+		pushID(id);
+		bindFramebuffer(framebufferData.framebufferID);
+		return true;
+	}
+
+	void stopFramebuffer() {
+		popID();
+
+		bindFramebuffer(0);
+	}
+
+	GLuint getFramebufferID() {
+		StdGLID id = getID("");
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+
+		return framebufferData.framebufferID;
+	}
+
+	GLuint getFramebufferTextureID(int attachmentIndex, FramebufferAttachmentType type) {
+		StdGLID id = getID("");
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+
+		return framebufferData.attachments[type].at(attachmentIndex).textureID;
+	}
+
+	Vec2 getFramebufferSize() {
+		StdGLID id = getID("");
+		FramebufferData& framebufferData = g_framebufferDataMap[id];
+
+		return { framebufferData.width, framebufferData.height };
+	}
+
+	//---------------------------------------------------------------
+	// [SECTION] Uniform buffer
+	//---------------------------------------------------------------
+
+	#ifndef STDGL_UNIFORM_RING_REGION_SIZE
+	#define STDGL_UNIFORM_RING_REGION_SIZE (1 << 20)
+	#endif
+
+	// One persistently mapped buffer split into a region per frame in flight.
+	// A region is only rewritten once the fence placed after its frame has signaled.
+	struct UniformRingData {
+		GLuint bufferID;
+		unsigned char* mapping;
+		GLintptr alignment;
+
+		GLsync fences[STDGL_FRAMES_IN_FLIGHT];
+		unsigned int region;
+		GLintptr offset; // Offset into the current region
+		bool frameActive;
+
+		UniformAllocation frameCamera; // Camera block written by beginRender
+		bool cameraOverridden; // shaderLoadCamera bound another camera in its place
+
+		UniformRingData() : bufferID(0), mapping(nullptr), alignment(256), fences(), region(0), offset(0), frameActive(false), frameCamera(), cameraOverridden(false) {}
+	};
+
+	static UniformRingData g_uniformRing;
+
+	void initializeUniformRing() {
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		g_uniformRing.alignment = alignment;
+
+		const GLsizeiptr bufferSize = (GLsizeiptr)STDGL_UNIFORM_RING_REGION_SIZE * STDGL_FRAMES_IN_FLIGHT;
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glGenBuffers(1, &g_uniformRing.bufferID);
+		glBindBuffer(GL_UNIFORM_BUFFER, g_uniformRing.bufferID);
+		glBufferStorage(GL_UNIFORM_BUFFER, bufferSize, nullptr, flags);
+		g_uniformRing.mapping = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, bufferSize, flags);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		STDGL_ASSERT(g_uniformRing.mapping != nullptr);
+		STDGL_LOG_DEBUG_F("Uniform ring created: {} regions of {} bytes", STDGL_FRAMES_IN_FLIGHT, STDGL_UNIFORM_RING_REGION_SIZE);
+	}
+
+	void destroyUniformRing() {
+		if (g_uniformRing.bufferID == 0) {
+			return;
+		}
+
+		for (GLsync& fence : g_uniformRing.fences) {
+			if (fence) {
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+
+		glBindBuffer(GL_UNIFORM_BUFFER, g_uniformRing.bufferID);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glDeleteBuffers(1, &g_uniformRing.bufferID);
+
+		g_uniformRing = UniformRingData();
+	}
+
+	void beginUniformFrame() {
+		if (g_uniformRing.bufferID == 0) {
+			initializeUniformRing();
+		}
+		if (g_uniformRing.frameActive) {
+			return;
+		}
+
+		// Wait until the GPU is done reading this region
+		GLsync& fence = g_uniformRing.fences[g_uniformRing.region];
+		if (fence) {
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			while (result == GL_TIMEOUT_EXPIRED) {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+			}
+			if (result == GL_WAIT_FAILED) {
+				STDGL_LOG_ERROR("Uniform ring fence wait failed");
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		g_uniformRing.offset = 0;
+		g_uniformRing.frameActive = true;
+	}
+
+	void endUniformFrame() {
+		if (!g_uniformRing.frameActive) {
+			return;
+		}
+
+		g_uniformRing.fences[g_uniformRing.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		g_uniformRing.region = (g_uniformRing.region + 1) % STDGL_FRAMES_IN_FLIGHT;
+		g_uniformRing.frameActive = false;
+		g_uniformRing.frameCamera = UniformAllocation();
+		g_uniformRing.cameraOverridden = false;
+	}
+
+	// Called from newFrame, a beginRender without endRender would otherwise keep filling the same region
+	void newUniformFrame() {
+		if (g_uniformRing.frameActive) {
+			STDGL_LOG_ERROR("beginRender without endRender, the uniform ring region is closed by newFrame");
+			endUniformFrame();
+		}
+	}
+
+	// Writes the camera block of shaders that declare CameraData, false outside beginRender/endRender
+	bool loadCameraBlock(const Camera& camera) {
+		UniformRingData& ring = g_uniformRing;
+		if (!ring.frameActive) {
+			return false;
+		}
+
+		// The frame camera is already in the ring, rebind it if another camera took its place
+		const RenderContext& renderContext = g_stdglContext->renderContext;
+		if (renderContext.camera.get() == &camera && ring.frameCamera.data != nullptr) {
+			if (ring.cameraOverridden) {
+				bindUniforms(ring.frameCamera, CAMERA_UNIFORM_BINDING);
+				ring.cameraOverridden = false;
+			}
+			return true;
+		}
+
+		const glm::mat4 view = camera.getMatrix();
+		CameraUniforms cameraUniforms = { camera.projection, view, camera.projection * view, glm::vec4(camera.position, 1.0f) };
+		if (loadUniformBlock(CAMERA_UNIFORM_BINDING, cameraUniforms).data == nullptr) {
+			return false;
+		}
+		ring.cameraOverridden = true;
+		return true;
+	}
+
+	UniformAllocation allocateUniforms(GLsizeiptr size) {
+		STDGL_ASSERT(g_uniformRing.frameActive);
+
+		GLintptr alignment = g_uniformRing.alignment;
+		GLintptr offset = (g_uniformRing.offset + alignment - 1) / alignment * alignment;
+
+		if (!g_uniformRing.frameActive || offset + size > STDGL_UNIFORM_RING_REGION_SIZE) {
+			STDGL_LOG_ERROR_F("Uniform ring out of space, requested {} bytes", size);
+			return { g_uniformRing.bufferID, 0, 0, nullptr };
+		}
+		g_uniformRing.offset = offset + size;
+
+		GLintptr bufferOffset = (GLintptr)g_uniformRing.region * STDGL_UNIFORM_RING_REGION_SIZE + offset;
+		return { g_uniformRing.bufferID, bufferOffset, size, g_uniformRing.mapping + bufferOffset };
+	}
+
+	void bindUniforms(const UniformAllocation& allocation, GLuint binding) {
+		if (allocation.data == nullptr) {
+			return;
+		}
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, allocation.bufferID, allocation.offset, allocation.size);
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Render queue
+	//---------------------------------------------------------------
+
+	// Sort key layout, most significant first:
+	// [63..48] program | [47..32] texture set | [31..16] vao | [15..0] depth (front to back)
+	typedef unsigned long long RenderSortKey;
+
+	// Meshes are referenced, not copied, and must stay alive until the queue is submitted in endRender
+	struct RenderCommand {
+		const Mesh* mesh;
+		ShaderData* shaderData;
+		unsigned int level; // LOD picked when the mesh was queued
+		bool skipTextures;
+		unsigned int uniformBegin, uniformEnd; // Range of RenderQueueData::snapshots
+	};
+
+	// A uniform loaded while queuing
+	struct QueuedUniform {
+		const ShaderData* shaderData;
+		GLint location;
+		UniformValueType type;
+		float value[16]; // Raw bytes, ints included
+	};
+
+	// Vectors are cleared, never shrunk, so the queue stops allocating after the first frames
+	struct RenderQueueData {
+		std::vector<RenderCommand> commands;
+		std::vector<RenderSortKey> keys;
+
+		// Uniforms of each command as they were when it was queued, consecutive commands share a snapshot
+		// until a uniform of their shader changes
+		std::vector<QueuedUniform> uniforms; // Latest value per shader and location
+		std::vector<QueuedUniform> snapshots;
+		const ShaderData* snapshotShader;
+		unsigned int snapshotBegin, snapshotEnd;
+		bool snapshotDirty;
+
+		// Radix sort scratch
+		std::vector<RenderSortKey> sortKeys;
+		std::vector<unsigned int> sortIndices;
+		std::vector<RenderSortKey> tempKeys;
+		std::vector<unsigned int> tempIndices;
+
+		RenderQueueData() : snapshotShader(nullptr), snapshotBegin(0), snapshotEnd(0), snapshotDirty(true) {}
+	};
+
+	static RenderQueueData g_renderQueue;
+
+	void recordQueuedUniform(GLint location, UniformValueType type, const void* value) {
+		const ShaderData* shaderData = g_activeShaderData;
+		if (location < 0 || shaderData == nullptr) {
+			return;
+		}
+
+		QueuedUniform uniform = { shaderData, location, type, {} };
+		std::memcpy(uniform.value, value, getUniformValueSize(type));
+
+		std::vector<QueuedUniform>& uniforms = g_renderQueue.uniforms;
+		auto it = std::find_if(uniforms.begin(), uniforms.end(), [&](const QueuedUniform& other) { return other.shaderData == shaderData && other.location == location; });
+		if (it != uniforms.end()) {
+			*it = uniform;
+		}
+		else {
+			uniforms.push_back(uniform);
+		}
+		g_renderQueue.snapshotDirty = true;
+	}
+
+	RenderSortKey makeSortKey(const Mesh& mesh, const ShaderData* shaderData, bool skipTextures) {
+		const RenderContext& renderContext = g_stdglContext->renderContext;
+
+		StdGLID textureSet = 0;
+		if (!skipTextures) {
+			for (const Texture& texture : mesh.textures) {
+				textureSet = hashStr((const char*)&texture.textureID, sizeof(GLuint), textureSet);
+			}
+		}
+
+		unsigned int depth = 0;
+		if (renderContext.camera) {
+			glm::vec4 viewPosition = renderContext.view * glm::vec4(mesh.center, 1.0f);
+			float normalizedDepth = glm::clamp(-viewPosition.z / renderContext.camera->zFar, 0.0f, 1.0f);
+			depth = (unsigned int)(normalizedDepth * 0xFFFF);
+		}
+
+		GLuint program = shaderData ? shaderData->programID : 0;
+		return ((RenderSortKey)(program & 0xFFFF) << 48)
+			| ((RenderSortKey)(textureSet & 0xFFFF) << 32)
+			| ((RenderSortKey)(mesh.vao & 0xFFFF) << 16)
+			| (RenderSortKey)(depth & 0xFFFF);
+	}
+
+	void queueMesh(const Mesh& mesh, unsigned int level, bool skipTextures) {
+		if (!isMeshLoaded(mesh)) {
+			return;
+		}
+		ShaderData* shaderData = g_activeShaderData;
+
+		RenderQueueData& queue = g_renderQueue;
+		if (queue.snapshotDirty || queue.snapshotShader != shaderData) {
+			queue.snapshotBegin = (unsigned int)queue.snapshots.size();
+			for (const QueuedUniform& uniform : queue.uniforms) {
+				if (uniform.shaderData == shaderData) {
+					queue.snapshots.push_back(uniform);
+				}
+			}
+			queue.snapshotEnd = (unsigned int)queue.snapshots.size();
+			queue.snapshotShader = shaderData;
+			queue.snapshotDirty = false;
+		}
+
+		queue.keys.push_back(makeSortKey(mesh, shaderData, skipTextures));
+		queue.commands.push_back({ &mesh, shaderData, level, skipTextures, queue.snapshotBegin, queue.snapshotEnd });
+	}
+
+	// LSD radix sort over 8 bit digits, passes where every key shares the digit are skipped
+	void sortRenderQueue() {
+		const size_t count = g_renderQueue.keys.size();
+
+		std::vector<RenderSortKey>& keys = g_renderQueue.sortKeys;
+		std::vector<unsigned int>& indices = g_renderQueue.sortIndices;
+		std::vector<RenderSortKey>& tempKeys = g_renderQueue.tempKeys;
+		std::vector<unsigned int>& tempIndices = g_renderQueue.tempIndices;
+
+		keys.assign(g_renderQueue.keys.begin(), g_renderQueue.keys.end());
+		indices.resize(count);
+		tempKeys.resize(count);
+		tempIndices.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			indices[i] = (unsigned int)i;
+		}
+
+		for (unsigned int shift = 0; shift < 64; shift += 8) {
+			size_t histogram[256] = {};
+			for (size_t i = 0; i < count; ++i) {
+				++histogram[(keys[i] >> shift) & 0xFF];
+			}
+			if (histogram[(keys[0] >> shift) & 0xFF] == count) {
+				continue;
+			}
+
+			size_t offset = 0;
+			for (size_t& bucket : histogram) {
+				size_t bucketSize = bucket;
+				bucket = offset;
+				offset += bucketSize;
+			}
+
+			for (size_t i = 0; i < count; ++i) {
+				size_t target = histogram[(keys[i] >> shift) & 0xFF]++;
+				tempKeys[target] = keys[i];
+				tempIndices[target] = indices[i];
+			}
+			keys.swap(tempKeys);
+			indices.swap(tempIndices);
+		}
+	}
+
+	void drawMeshInternal(const Mesh& mesh, unsigned int level, bool skipTextures);
+
+	void submitRenderQueue() {
+		STDGL_CPU_ZONE("submitRenderQueue");
+
+		if (g_renderQueue.commands.empty()) {
+			return;
+		}
+
+		sortRenderQueue();
+
+		ShaderData* previousShaderData = g_activeShaderData;
+		ShaderData* boundShaderData = nullptr;
+		bool first = true;
+		unsigned int appliedBegin = 0, appliedEnd = 0;
+
+		RenderQueueData& queue = g_renderQueue;
+		for (unsigned int index : queue.sortIndices) {
+			const RenderCommand& command = queue.commands[index];
+			if (first || command.shaderData != boundShaderData) {
+				boundShaderData = command.shaderData;
+				g_activeShaderData = boundShaderData;
+				bindProgram(boundShaderData ? boundShaderData->programID : 0);
+				first = false;
+			}
+			if (command.uniformBegin != appliedBegin || command.uniformEnd != appliedEnd) {
+				for (unsigned int i = command.uniformBegin; i < command.uniformEnd; ++i) {
+					applyUniformValue(queue.snapshots[i].location, queue.snapshots[i].type, queue.snapshots[i].value);
+				}
+				appliedBegin = command.uniformBegin;
+				appliedEnd = command.uniformEnd;
+			}
+			drawMeshInternal(*command.mesh, command.level, command.skipTextures);
+		}
+
+		// Leave every program with the values loaded last, as immediate mode would
+		for (const QueuedUniform& uniform : queue.uniforms) {
+			bindProgram(uniform.shaderData->programID);
+			applyUniformValue(uniform.location, uniform.type, uniform.value);
+		}
+
+		g_activeShaderData = previousShaderData;
+		bindProgram(previousShaderData != nullptr ? previousShaderData->programID : 0);
+
+		queue.commands.clear();
+		queue.keys.clear();
+		queue.uniforms.clear();
+		queue.snapshots.clear();
+		queue.snapshotShader = nullptr;
+		queue.snapshotDirty = true;
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Renderer
+	//---------------------------------------------------------------
+
+	void beginRender(std::shared_ptr<Camera> camera, RenderMode renderMode) {
+		// Bind the renderer
+		RenderContext& renderContext = g_stdglContext->renderContext;
+		if (renderContext.camera != camera) {
+			renderContext.camera = camera;
+		}
+		renderContext.renderMode = renderMode;
+
+		beginUniformFrame();
+
+		// Upload the camera once for the whole frame
+		if (renderContext.camera) {
+			const Camera& frameCamera = *renderContext.camera;
+			renderContext.view = frameCamera.getMatrix();
+			renderContext.viewProjection = frameCamera.projection * renderContext.view;
+
+			CameraUniforms cameraUniforms = { frameCamera.projection, renderContext.view, renderContext.viewProjection, glm::vec4(frameCamera.position, 1.0f) };
+			g_uniformRing.frameCamera = loadUniformBlock(CAMERA_UNIFORM_BINDING, cameraUniforms);
+			g_uniformRing.cameraOverridden = false;
+		}
+	}
+
+	void endRender() {
+		// Unbind the renderer, uniforms loaded while the queue executes are not recorded
+		g_stdglContext->renderContext.renderMode = RenderMode::IMMEDIATE;
+		submitRenderQueue();
+		endUniformFrame();
+	}
+
+	void clearFramebuffer() {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	void useCamera(std::shared_ptr<Camera> camera) {
+		if (g_stdglContext->renderContext.camera != camera) {
+			g_stdglContext->renderContext.camera = camera;
+		}
+	}
+
+	std::shared_ptr<Camera> getCamera() {
+		return g_stdglContext->renderContext.camera;
+	}
+
+	void setRendererSize(int width, int height) {
+		RenderContext& renderContext = g_stdglContext->renderContext;
+
+		if (width < 0) width = 0;
+		if (height < 0) height = 0;
+
+		renderContext.width = width;
+		renderContext.height = height;
+
+		if (renderContext.camera && width > 0 && height > 0) {
+			renderContext.camera->projection = renderContext.camera->generateProjection();
+		}
+	}
+
+	void setLODSettings(const LODSettings& settings) {
+		g_stdglContext->renderContext.lodSettings = settings;
+	}
+
+	unsigned int selectMeshLOD(const Mesh& mesh, const glm::mat4& transform, unsigned int previousLevel) {
+		const RenderContext& renderContext = g_stdglContext->renderContext;
+		const LODSettings& settings = renderContext.lodSettings;
+		if (mesh.lods.empty() || !renderContext.camera || settings.pixelError <= 0.0f || renderContext.height <= 0) {
+			return 0;
+		}
+
+		// The largest axis scale bounds how much the transform stretches the sphere and the simplification error
+		const float scale = std::sqrt(std::max({ glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+			glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])) }));
+		const glm::vec3 center = glm::vec3(transform * glm::vec4(mesh.center, 1.0f));
+
+		// Pixels per model unit at the nearest point of the bounding sphere
+		const Camera& camera = *renderContext.camera;
+		const float focalLength = camera.projection[2][3] != 0.0f ? camera.projection[1][1] : 1.0f / std::tan(camera.fov * 0.5f);
+		const float distance = std::max(glm::length(center - camera.position) - mesh.radius * scale, camera.zNear);
+		const float pixelsPerUnit = scale * focalLength * renderContext.height * 0.5f / distance;
+
+		unsigned int level = 0;
+		for (unsigned int i = 0; i < mesh.lods.size(); ++i) {
+			if (mesh.lods[i].error * pixelsPerUnit <= settings.pixelError) {
+				level = i + 1;
+			}
+		}
+
+		// Coarsen only once clearly below the threshold, refine immediately
+		if (level > previousLevel) {
+			const float coarsenError = settings.pixelError * (1.0f - settings.hysteresis);
+			unsigned int coarser = previousLevel;
+			for (unsigned int i = previousLevel; i < level; ++i) {
+				if (mesh.lods[i].error * pixelsPerUnit <= coarsenError) {
+					coarser = i + 1;
+				}
+			}
+			level = coarser;
+		}
+
+		return level;
+	}
+
+	// Index range of the level selected for this draw
+	void getMeshDrawRange(const Mesh& mesh, unsigned int level, GLuint& firstIndex, GLsizei& indiceCount) {
+		if (level == 0 || level > mesh.lods.size()) {
+			firstIndex = mesh.firstIndex;
+			indiceCount = mesh.indiceCount;
+			return;
+		}
+		firstIndex = mesh.lods[level - 1].firstIndex;
+		indiceCount = mesh.lods[level - 1].indiceCount;
+	}
+
+	void bindMeshTextures(const Mesh& mesh) {
+		// Load mesh textures
+		unsigned int diffuseCounter = 0;
+		unsigned int specularCounter = 0;
+		for (unsigned int i = 0; i < mesh.textures.size(); ++i) {
+			std::string name;
+			if (mesh.textures[i].type == TextureType::DIFFUSE) {
+				name = "texture_diffuse" + std::to_string(++diffuseCounter);
+			}
+			else if (mesh.textures[i].type == TextureType::SPECULAR) {
+				name = "texture_specular" + std::to_string(++specularCounter);
+			}
+
+			shaderLoadInt(name.c_str(), i);
+			bindTexture2D(i, getBindableTexture(mesh.textures[i]));
+		}
+	}
+
+	void loadPositionDequantization(const Mesh& mesh) {
+		const ShaderData* shaderData = g_activeShaderData;
+		if (shaderData == nullptr) {
+			return;
+		}
+		if (shaderData->positionScaleLocation >= 0) {
+			glUniform3fv(shaderData->positionScaleLocation, 1, glm::value_ptr(mesh.positionScale));
+		}
+		if (shaderData->positionOffsetLocation >= 0) {
+			glUniform3fv(shaderData->positionOffsetLocation, 1, glm::value_ptr(mesh.positionOffset));
+		}
+	}
+
+	void drawMeshInstances(const Mesh& mesh, GLsizei instanceCount, bool skipTextures) {
+		if (!isMeshLoaded(mesh)) {
+			return;
+		}
+		if (!skipTextures) {
+			bindMeshTextures(mesh);
+		}
+		loadPositionDequantization(mesh);
+
+		bindVertexArray(mesh.vao);
+
+		if (mesh.type == MeshType::ArrayMesh) {
+			glDrawArraysInstancedBaseInstance(mesh.mode, 0, mesh.vertexCount, instanceCount, 1);
+		}
+		else if (mesh.type == MeshType::ElementMesh) {
+			glDrawElementsInstancedBaseVertexBaseInstance(mesh.mode, mesh.indiceCount, mesh.indexType, (void*)(mesh.firstIndex * getIndexTypeSize(mesh.indexType)), instanceCount, mesh.baseVertex, 1);
+		}
+	}
+
+	void drawMeshLevel(const Mesh& mesh, unsigned int level, bool skipTextures) {
+		if (g_stdglContext->renderContext.renderMode == RenderMode::QUEUED) {
+			queueMesh(mesh, level, skipTextures);
+			return;
+		}
+		drawMeshInternal(mesh, level, skipTextures);
+	}
+
+	void drawMesh(const Mesh& mesh, bool skipTextures) {
+		mesh.lod = selectMeshLOD(mesh, glm::mat4(1.0f), mesh.lod);
+		drawMeshLevel(mesh, mesh.lod, skipTextures);
+	}
+
+	void drawMeshInternal(const Mesh& mesh, unsigned int level, bool skipTextures) {
+		if (!isMeshLoaded(mesh)) {
+			return;
+		}
+		if (!skipTextures) {
+			bindMeshTextures(mesh);
+		}
+		loadPositionDequantization(mesh);
+		
+		// Load vertex buffer and call draw command
+		bindVertexArray(mesh.vao);
+		
+		if (mesh.type == MeshType::ArrayMesh) {
+			glDrawArrays(mesh.mode, 0, mesh.vertexCount);
+		}
+		else if (mesh.type == MeshType::ElementMesh) {
+			GLuint firstIndex;
+			GLsizei indiceCount;
+			getMeshDrawRange(mesh, level, firstIndex, indiceCount);
+
+			const void* offset = (void*)(firstIndex * getIndexTypeSize(mesh.indexType));
+			if (mesh.shared) {
+				glDrawElementsBaseVertex(mesh.mode, indiceCount, mesh.indexType, offset, mesh.baseVertex);
+			}
+			else {
+				glDrawElements(mesh.mode, indiceCount, mesh.indexType, offset);
+			}
+		}
+	}
+
+	//// Frustum culling
+	struct CullingData {
+		ModelBounds scratchBounds; // For models whose bounds are out of date
+		std::vector<unsigned int> visibleMeshes;
+		CullingStats stats, lastStats; // Current and previous frame
+	};
+
+	static CullingData g_culling;
+
+	void fillModelBounds(ModelBounds& bounds, const std::vector<Mesh>& meshes);
+
+	void setFrustumCulling(bool enabled) {
+		g_stdglContext->renderContext.frustumCulling = enabled;
+	}
+
+	CullingStats getCullingStats() {
+		return g_culling.lastStats;
+	}
+
+	void newOcclusionFrame();
+
+	void newCullingFrame() {
+		g_culling.lastStats = g_culling.stats;
+		g_culling.stats = CullingStats();
+		newOcclusionFrame();
+	}
+
+	// Gribb-Hartmann, the planes are in the space the matrix maps from. Unnormalized, only the sign is tested.
+	void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]) {
+		const glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+		const glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+		const glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+		const glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+		planes[0] = row3 + row0; // Left
+		planes[1] = row3 - row0; // Right
+		planes[2] = row3 + row1; // Bottom
+		planes[3] = row3 - row1; // Top
+		planes[4] = row3 + row2; // Near
+		planes[5] = row3 - row2; // Far
+	}
+
+	// An AABB is outside when it lies fully behind one plane: dot(n, center) + w + dot(|n|, extent) < 0
+	void cullBounds(const ModelBounds& bounds, const glm::vec4 planes[6], std::vector<unsigned int>& visible) {
+		visible.clear();
+
+	#ifdef STDGL_SSE
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm_set1_ps(planes[p].x);
+			planeY[p] = _mm_set1_ps(planes[p].y);
+			planeZ[p] = _mm_set1_ps(planes[p].z);
+			planeW[p] = _mm_set1_ps(planes[p].w);
+			absX[p] = _mm_andnot_ps(signMask, planeX[p]);
+			absY[p] = _mm_andnot_ps(signMask, planeY[p]);
+			absZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+		}
+
+		for (size_t i = 0; i < bounds.count; i += 4) {
+			const __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+			const __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+			const __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+			const __m128 extentX = _mm_loadu_ps(&bounds.extentX[i]);
+			const __m128 extentY = _mm_loadu_ps(&bounds.extentY[i]);
+			const __m128 extentZ = _mm_loadu_ps(&bounds.extentZ[i]);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; ++p) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)), _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], extentX), _mm_mul_ps(absY[p], extentY)), _mm_mul_ps(absZ[p], extentZ));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+
+			int outsideMask = _mm_movemask_ps(outside);
+			for (size_t lane = 0; lane < 4 && i + lane < bounds.count; ++lane) {
+				if ((outsideMask & (1 << lane)) == 0) {
+					visible.push_back((unsigned int)(i + lane));
+				}
+			}
+		}
+	#else
+		for (size_t i = 0; i < bounds.count; ++i) {
+			bool outside = false;
+			for (int p = 0; p < 6 && !outside; ++p) {
+				float distance = planes[p].x * bounds.centerX[i] + planes[p].y * bounds.centerY[i] + planes[p].z * bounds.centerZ[i] + planes[p].w;
+				float radius = std::abs(planes[p].x) * bounds.extentX[i] + std::abs(planes[p].y) * bounds.extentY[i] + std::abs(planes[p].z) * bounds.extentZ[i];
+				outside = distance + radius < 0.0f;
+			}
+			if (!outside) {
+				visible.push_back((unsigned int)i);
+			}
+		}
+	#endif
+	}
+
+	//// Occlusion culling
+	#ifndef STDGL_OCCLUSION_READBACK_WIDTH
+	#define STDGL_OCCLUSION_READBACK_WIDTH 256 // Widest pyramid level copied to the CPU
+	#endif
+
+	#ifndef STDGL_OCCLUSION_DEPTH_BIAS
+	#define STDGL_OCCLUSION_DEPTH_BIAS 1e-6f // Keeps surfaces lying on their own bounds from occluding themselves
+	#endif
+
+	// Each texel keeps the farthest depth of the source texels it overlaps, odd sizes overlap by one so none is missed
+	static const char* g_depthPyramidShaderSource = R"(#version 430
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D source;
+layout(binding = 0, r32f) uniform writeonly image2D destination;
+layout(location = 0) uniform int sourceLevel;
+
+void main() {
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 destinationSize = imageSize(destination);
+	if (any(greaterThanEqual(texel, destinationSize))) {
+		return;
+	}
+
+	ivec2 sourceSize = textureSize(source, sourceLevel);
+	ivec2 begin = texel * sourceSize / destinationSize;
+	ivec2 end = ((texel + 1) * sourceSize + destinationSize - 1) / destinationSize;
+
+	float depth = 0.0;
+	for (int y = begin.y; y < end.y; ++y) {
+		for (int x = begin.x; x < end.x; ++x) {
+			depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+		}
+	}
+	imageStore(destination, texel, vec4(depth));
+}
+)";
+
+	struct DepthPyramidLevel {
+		int width, height;
+		std::vector<float> depth;
+	};
+
+	struct OcclusionData {
+		bool initialized;
+		bool supported;
+		bool built; // buildDepthPyramid was called since the last newFrame
+
+		GLuint programID;
+		GLuint pyramidID; // R32F, level 0 is half the depth attachment, the last level is read back
+		int width, height; // Depth attachment size the pyramid is allocated for
+		int levelCount;
+		int readbackWidth, readbackHeight;
+
+		GLuint readbackBufferID; // Persistently mapped
+		float* readbackMapping;
+		GLsync fence;
+		glm::mat4 pendingViewProjection;
+
+		std::vector<DepthPyramidLevel> levels; // CPU copy, levels[0] is the read back level
+		glm::mat4 viewProjection; // Camera the CPU copy was rendered with
+
+		OcclusionData() : initialized(false), supported(false), built(false), programID(0), pyramidID(0), width(0), height(0), levelCount(0), readbackWidth(0), readbackHeight(0),
+			readbackBufferID(0), readbackMapping(nullptr), fence(nullptr), pendingViewProjection(1.0f), levels(), viewProjection(1.0f) {}
+	};
+
+	static OcclusionData g_occlusion;
+
+	void setOcclusionCulling(bool enabled) {
+		g_stdglContext->renderContext.occlusionCulling = enabled;
+		if (!enabled) {
+			g_occlusion.levels.clear();
+		}
+	}
+
+	bool initializeOcclusion() {
+		OcclusionData& occlusion = g_occlusion;
+		if (occlusion.initialized) {
+			return occlusion.supported;
+		}
+		occlusion.initialized = true;
+
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major < 4 || (major == 4 && minor < 3)) {
+			STDGL_LOG_ERROR("Occlusion culling needs compute shaders (OpenGL 4.3), disabled");
+			return false;
+		}
+
+		GLuint shader = compileShader(g_depthPyramidShaderSource, GL_COMPUTE_SHADER);
+		GLuint program = glCreateProgram();
+		glAttachShader(program, shader);
+		glLinkProgram(program);
+
+		GLint linkResult = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linkResult);
+		if (linkResult != GL_TRUE) {
+			checkShaderCompile(shader);
+			STDGL_LOG_ERROR("Depth pyramid shader failed to link, occlusion culling disabled");
+			glDeleteProgram(program);
+			glDeleteShader(shader);
+			return false;
+		}
+
+		glDetachShader(program, shader);
+		glDeleteShader(shader);
+		occlusion.programID = program;
+		occlusion.supported = true;
+		return true;
+	}
+
+	void releaseDepthPyramid(OcclusionData& occlusion) {
+		if (occlusion.fence) {
+			glDeleteSync(occlusion.fence);
+			occlusion.fence = nullptr;
+		}
+		if (occlusion.readbackBufferID != 0) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, occlusion.readbackBufferID);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			glDeleteBuffers(1, &occlusion.readbackBufferID);
+			occlusion.readbackBufferID = 0;
+			occlusion.readbackMapping = nullptr;
+		}
+		if (occlusion.pyramidID != 0) {
+			glDeleteTextures(1, &occlusion.pyramidID);
+			forgetTexture(occlusion.pyramidID);
+			occlusion.pyramidID = 0;
+		}
+	}
+
+	// Only the levels down to the readback size live on the GPU, the rest is reduced on the CPU
+	void allocateDepthPyramid(OcclusionData& occlusion, int width, int height) {
+		releaseDepthPyramid(occlusion);
+
+		occlusion.width = width;
+		occlusion.height = height;
+		occlusion.levelCount = 0;
+		int levelWidth = width, levelHeight = height;
+		do {
+			levelWidth = std::max(1, levelWidth / 2);
+			levelHeight = std::max(1, levelHeight / 2);
+			++occlusion.levelCount;
+		} while (levelWidth > STDGL_OCCLUSION_READBACK_WIDTH);
+		occlusion.readbackWidth = levelWidth;
+		occlusion.readbackHeight = levelHeight;
+
+		glGenTextures(1, &occlusion.pyramidID);
+		bindTexture2D(0, occlusion.pyramidID);
+		glTexStorage2D(GL_TEXTURE_2D, occlusion.levelCount, GL_R32F, std::max(1, width / 2), std::max(1, height / 2));
+
+		const GLsizeiptr readbackSize = (GLsizeiptr)levelWidth * levelHeight * sizeof(float);
+		const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &occlusion.readbackBufferID);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, occlusion.readbackBufferID);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, readbackSize, nullptr, flags);
+		occlusion.readbackMapping = (float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readbackSize, flags);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		STDGL_ASSERT(occlusion.readbackMapping != nullptr);
+	}
+
+	// Never stalls, a finished readback becomes the CPU pyramid
+	void pollOcclusionReadback() {
+		OcclusionData& occlusion = g_occlusion;
+		if (!occlusion.fence) {
+			return;
+		}
+
+		GLenum result = glClientWaitSync(occlusion.fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			return;
+		}
+		glDeleteSync(occlusion.fence);
+		occlusion.fence = nullptr;
+
+		// Same 2x2 max reduction as the GPU, sizes round up so the last row and column are kept
+		std::vector<DepthPyramidLevel>& levels = occlusion.levels;
+		size_t levelCount = 1;
+		for (int width = occlusion.readbackWidth, height = occlusion.readbackHeight; width > 1 || height > 1; ++levelCount) {
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+		}
+		levels.resize(levelCount);
+
+		levels[0].width = occlusion.readbackWidth;
+		levels[0].height = occlusion.readbackHeight;
+		levels[0].depth.assign(occlusion.readbackMapping, occlusion.readbackMapping + (size_t)occlusion.readbackWidth * occlusion.readbackHeight);
+
+		for (size_t l = 1; l < levelCount; ++l) {
+			const DepthPyramidLevel& source = levels[l - 1];
+			DepthPyramidLevel& level = levels[l];
+			level.width = (source.width + 1) / 2;
+			level.height = (source.height + 1) / 2;
+			level.depth.resize((size_t)level.width * level.height);
+
+			for (int y = 0; y < level.height; ++y) {
+				const float* row0 = &source.depth[(size_t)(y * 2) * source.width];
+				const float* row1 = &source.depth[(size_t)std::min(y * 2 + 1, source.height - 1) * source.width];
+				for (int x = 0; x < level.width; ++x) {
+					const int x0 = x * 2;
+					const int x1 = std::min(x0 + 1, source.width - 1);
+					level.depth[(size_t)y * level.width + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+				}
+			}
+		}
+
+		occlusion.viewProjection = occlusion.pendingViewProjection;
+	}
+
+	void newOcclusionFrame() {
+		OcclusionData& occlusion = g_occlusion;
+		if (!occlusion.built) {
+			occlusion.levels.clear();
+		}
+		occlusion.built = false;
+		pollOcclusionReadback();
+	}
+
+	void buildDepthPyramid(const char* framebufferName) {
+		STDGL_CPU_ZONE("buildDepthPyramid");
+
+		OcclusionData& occlusion = g_occlusion;
+		if (!g_stdglContext->renderContext.occlusionCulling || !initializeOcclusion()) {
+			return;
+		}
+		occlusion.built = true;
+
+		pollOcclusionReadback();
+		if (occlusion.fence) {
+			return; // The previous readback is still in flight
+		}
+
+		auto framebufferIt = g_framebufferDataMap.find(getID(framebufferName));
+		if (framebufferIt == g_framebufferDataMap.end() || framebufferIt->second.framebufferID == 0) {
+			return;
+		}
+
+		const FramebufferData& framebufferData = framebufferIt->second;
+		auto depthIt = framebufferData.attachments.find(FramebufferAttachmentType::DEPTH);
+		if (depthIt == framebufferData.attachments.end() || depthIt->second.empty()) {
+			STDGL_LOG_ERROR_F("Framebuffer {} has no depth attachment", framebufferName);
+			return;
+		}
+		const GLuint depthTextureID = depthIt->second.begin()->second.textureID;
+
+		if (occlusion.width != framebufferData.width || occlusion.height != framebufferData.height) {
+			allocateDepthPyramid(occlusion, framebufferData.width, framebufferData.height);
+		}
+
+		bindProgram(occlusion.programID);
+
+		int width = framebufferData.width, height = framebufferData.height;
+		for (int level = 0; level < occlusion.levelCount; ++level) {
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+
+			bindTexture2D(0, level == 0 ? depthTextureID : occlusion.pyramidID);
+			glUniform1i(0, level == 0 ? 0 : level - 1);
+			glBindImageTexture(0, occlusion.pyramidID, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+		}
+		glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, occlusion.readbackBufferID);
+		bindTexture2D(0, occlusion.pyramidID);
+		glGetTexImage(GL_TEXTURE_2D, occlusion.levelCount - 1, GL_RED, GL_FLOAT, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		occlusion.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		occlusion.pendingViewProjection = g_stdglContext->renderContext.viewProjection;
+
+		bindProgram(g_activeShaderData != nullptr ? g_activeShaderData->programID : 0);
+	}
+
+	void destroyOcclusion() {
+		releaseDepthPyramid(g_occlusion);
+		if (g_occlusion.programID != 0) {
+			glDeleteProgram(g_occlusion.programID);
+		}
+		g_occlusion = OcclusionData();
+	}
+
+	bool hasDepthPyramid() {
+		return g_stdglContext->renderContext.occlusionCulling && !g_occlusion.levels.empty();
+	}
+
+	// matrix maps the bounds to the clip space of the pyramid. The box is hidden when its nearest depth lies behind
+	// the farthest depth of every texel its screen rectangle touches, read from the level where it spans at most 4x4.
+	bool isOccluded(const glm::mat4& matrix, const glm::vec3& minimum, const glm::vec3& maximum) {
+		float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f, minZ = 1.0f;
+		for (int corner = 0; corner < 8; ++corner) {
+			const glm::vec4 position((corner & 1) ? maximum.x : minimum.x, (corner & 2) ? maximum.y : minimum.y, (corner & 4) ? maximum.z : minimum.z, 1.0f);
+			const glm::vec4 clip = matrix * position;
+			if (clip.w <= 0.0f) {
+				return false; // Crosses the camera plane
+			}
+			const float x = clip.x / clip.w, y = clip.y / clip.w, z = clip.z / clip.w;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			minZ = std::min(minZ, z);
+		}
+
+		if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ < -1.0f) {
+			return false; // Outside the view the pyramid was rendered with, nothing is known about it
+		}
+
+		const std::vector<DepthPyramidLevel>& levels = g_occlusion.levels;
+		const int width = levels[0].width, height = levels[0].height;
+		const int x0 = std::clamp((int)((minX * 0.5f + 0.5f) * width), 0, width - 1);
+		const int x1 = std::clamp((int)((maxX * 0.5f + 0.5f) * width), 0, width - 1);
+		const int y0 = std::clamp((int)((minY * 0.5f + 0.5f) * height), 0, height - 1);
+		const int y1 = std::clamp((int)((maxY * 0.5f + 0.5f) * height), 0, height - 1);
+
+		size_t l = 0;
+		while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3)) {
+			++l;
+		}
+
+		const DepthPyramidLevel& level = levels[l];
+		float farthest = 0.0f;
+		for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+			for (int x = x0 >> l; x <= (x1 >> l); ++x) {
+				farthest = std::max(farthest, level.depth[(size_t)y * level.width + x]);
+			}
+		}
+
+		return minZ * 0.5f + 0.5f > farthest + STDGL_OCCLUSION_DEPTH_BIAS;
+	}
+
+	// Fills visible with the indices of the meshes to draw
+	void cullModel(const Model& model, const glm::mat4& transform, std::vector<unsigned int>& visible) {
+		const RenderContext& renderContext = g_stdglContext->renderContext;
+		if (!renderContext.frustumCulling || !renderContext.camera) {
+			visible.resize(model.meshes.size());
+			for (unsigned int i = 0; i < visible.size(); ++i) {
+				visible[i] = i;
+			}
+			return;
+		}
+
+		const ModelBounds* bounds = &model.bounds;
+		if (bounds->count != model.meshes.size()) {
+			fillModelBounds(g_culling.scratchBounds, model.meshes);
+			bounds = &g_culling.scratchBounds;
+		}
+
+		glm::vec4 planes[6];
+		extractFrustumPlanes(renderContext.viewProjection * transform, planes);
+		cullBounds(*bounds, planes, visible);
+
+		g_culling.stats.testedMeshes += (unsigned int)model.meshes.size();
+		g_culling.stats.culledMeshes += (unsigned int)(model.meshes.size() - visible.size());
+
+		if (hasDepthPyramid()) {
+			const glm::mat4 matrix = g_occlusion.viewProjection * transform;
+			size_t kept = 0;
+			for (unsigned int meshIndex : visible) {
+				const glm::vec3 center(bounds->centerX[meshIndex], bounds->centerY[meshIndex], bounds->centerZ[meshIndex]);
+				const glm::vec3 extent(bounds->extentX[meshIndex], bounds->extentY[meshIndex], bounds->extentZ[meshIndex]);
+				if (!isOccluded(matrix, center - extent, center + extent)) {
+					visible[kept++] = meshIndex;
+				}
+			}
+			g_culling.stats.occludedMeshes += (unsigned int)(visible.size() - kept);
+			visible.resize(kept);
+		}
+
+		g_culling.stats.visibleMeshes += (unsigned int)visible.size();
+	}
+
+	//// Multi-draw-indirect
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct IndirectDrawKey {
+		GLenum indexType;
+		unsigned int meshIndex;
+	};
+
+	// Orders meshes by the IDs of their bound texture set, 0 when both bind the same textures
+	int compareMeshTextures(const Mesh& a, const Mesh& b) {
+		const size_t count = std::min(a.textures.size(), b.textures.size());
+		for (size_t i = 0; i < count; ++i) {
+			if (a.textures[i].textureID != b.textures[i].textureID) {
+				return a.textures[i].textureID < b.textures[i].textureID ? -1 : 1;
+			}
+		}
+		return a.textures.size() == b.textures.size() ? 0 : (a.textures.size() < b.textures.size() ? -1 : 1);
+	}
+
+	struct IndirectDrawData {
+		GLuint bufferID;
+		GLsizeiptr capacity; // In bytes
+
+		// Scratch reused between calls
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<IndirectDrawKey> order;
+
+		IndirectDrawData() : bufferID(0), capacity(0) {}
+	};
+
+	static IndirectDrawData g_indirectDraw;
+
+	bool canDrawIndirect(const Model& model) {
+		if (model.meshes.size() < 2) {
+			return false;
+		}
+		// One arena and one dequantization for the whole batch
+		const Mesh& first = model.meshes[0];
+		for (const Mesh& mesh : model.meshes) {
+			if (!isMeshLoaded(mesh) || !mesh.shared || mesh.mode != first.mode || mesh.vao != first.vao
+				|| mesh.positionScale != first.positionScale || mesh.positionOffset != first.positionOffset) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Meshes are grouped by index type and texture set, each group is one glMultiDrawElementsIndirect
+	void drawModelIndirect(const Model& model, const glm::mat4& transform, const std::vector<unsigned int>& meshIndices, bool skipTextures) {
+		IndirectDrawData& indirect = g_indirectDraw;
+
+		indirect.order.clear();
+		for (unsigned int i : meshIndices) {
+			indirect.order.push_back({ model.meshes[i].indexType, i });
+		}
+		// Sorted on the texture IDs themselves, a hash collision would merge different texture sets into one batch
+		auto sameTextures = [&model, skipTextures](const IndirectDrawKey& a, const IndirectDrawKey& b) {
+			return skipTextures || compareMeshTextures(model.meshes[a.meshIndex], model.meshes[b.meshIndex]) == 0;
+		};
+		std::stable_sort(indirect.order.begin(), indirect.order.end(), [&model, skipTextures](const IndirectDrawKey& a, const IndirectDrawKey& b) {
+			if (a.indexType != b.indexType) {
+				return a.indexType < b.indexType;
+			}
+			return !skipTextures && compareMeshTextures(model.meshes[a.meshIndex], model.meshes[b.meshIndex]) < 0;
+		});
+
+		indirect.commands.clear();
+		for (const IndirectDrawKey& key : indirect.order) {
+			const Mesh& mesh = model.meshes[key.meshIndex];
+			GLuint firstIndex;
+			GLsizei indiceCount;
+			mesh.lod = selectMeshLOD(mesh, transform, mesh.lod);
+			getMeshDrawRange(mesh, mesh.lod, firstIndex, indiceCount);
+			indirect.commands.push_back({ (GLuint)indiceCount, 1, firstIndex, mesh.baseVertex, 0 });
+		}
+
+		// Stream the commands
+		const GLsizeiptr size = indirect.commands.size() * sizeof(DrawElementsIndirectCommand);
+		if (indirect.bufferID == 0) {
+			glGenBuffers(1, &indirect.bufferID);
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect.bufferID);
+		if (size > indirect.capacity) {
+			indirect.capacity = std::max<GLsizeiptr>(size, indirect.capacity * 2);
+		}
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, indirect.capacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, indirect.commands.data());
+
+		bindVertexArray(model.meshes[0].vao);
+		loadPositionDequantization(model.meshes[0]);
+
+		const GLenum mode = model.meshes[0].mode;
+		size_t begin = 0;
+		while (begin < indirect.order.size()) {
+			size_t end = begin + 1;
+			while (end < indirect.order.size() && end - begin < MAX_DRAWS_PER_BATCH
+				&& indirect.order[end].indexType == indirect.order[begin].indexType && sameTextures(indirect.order[end], indirect.order[begin])) {
+				++end;
+			}
+
+			if (!skipTextures) {
+				bindMeshTextures(model.meshes[indirect.order[begin].meshIndex]);
+			}
+
+			// Per-draw data indexed by gl_DrawID
+			if (g_uniformRing.frameActive) {
+				UniformAllocation allocation = allocateUniforms((end - begin) * sizeof(glm::uvec4));
+				if (allocation.data != nullptr) {
+					glm::uvec4* drawData = (glm::uvec4*)allocation.data;
+					for (size_t i = begin; i < end; ++i) {
+						drawData[i - begin] = { indirect.order[i].meshIndex, 0, 0, 0 };
+					}
+					bindUniforms(allocation, DRAW_UNIFORM_BINDING);
+				}
+			}
+
+			glMultiDrawElementsIndirect(mode, indirect.order[begin].indexType, (void*)(begin * sizeof(DrawElementsIndirectCommand)), (GLsizei)(end - begin), 0);
+			begin = end;
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	void drawModelMeshes(const Model& model, const glm::mat4& transform, std::vector<unsigned int>& visible, bool skipTextures) {
+		// Meshes unloaded behind the model's back are skipped on every path
+		visible.erase(std::remove_if(visible.begin(), visible.end(), [&model](unsigned int i) { return !isMeshLoaded(model.meshes[i]); }), visible.end());
+		if (visible.empty()) {
+			return;
+		}
+
+		if (g_stdglContext->renderContext.renderMode == RenderMode::IMMEDIATE && canDrawIndirect(model)) {
+			drawModelIndirect(model, transform, visible, skipTextures);
+			return;
+		}
+
+		for (unsigned int meshIndex : visible) {
+			const Mesh& mesh = model.meshes[meshIndex];
+			mesh.lod = selectMeshLOD(mesh, transform, mesh.lod);
+			drawMeshLevel(mesh, mesh.lod, skipTextures);
+		}
+	}
+
+	// Without the model transform the bounds cannot be placed in the world, so nothing is culled
+	void drawModel(const Model& model, bool skipTextures) {
+		STDGL_CPU_ZONE("drawModel");
+
+		std::vector<unsigned int>& visible = g_culling.visibleMeshes;
+		visible.resize(model.meshes.size());
+		for (unsigned int i = 0; i < visible.size(); ++i) {
+			visible[i] = i;
+		}
+		drawModelMeshes(model, glm::mat4(1.0f), visible, skipTextures);
+	}
+
+	void drawModel(const Model& model, const glm::mat4& transform, bool skipTextures) {
+		STDGL_CPU_ZONE("drawModel");
+
+		std::vector<unsigned int>& visible = g_culling.visibleMeshes;
+		cullModel(model, transform, visible);
+		drawModelMeshes(model, transform, visible, skipTextures);
+	}
+
+	void drawMeshInstanced(const Mesh& mesh, const glm::mat4* transforms, size_t count, bool skipTextures) {
+		if (count == 0) {
+			return;
+		}
+		uploadInstanceTransforms(transforms, count);
+		drawMeshInstances(mesh, (GLsizei)count, skipTextures);
+	}
+
+	void drawMeshInstanced(const Mesh& mesh, const std::vector<glm::mat4>& transforms, bool skipTextures) {
+		drawMeshInstanced(mesh, transforms.data(), transforms.size(), skipTextures);
+	}
+
+	void drawModelInstanced(const Model& model, const glm::mat4* transforms, size_t count, bool skipTextures) {
+		if (count == 0) {
+			return;
+		}
+		// Upload once, shared by every mesh in the model
+		uploadInstanceTransforms(transforms, count);
+		for (const Mesh& mesh : model.meshes) {
+			drawMeshInstances(mesh, (GLsizei)count, skipTextures);
+		}
+	}
+
+	void drawModelInstanced(const Model& model, const std::vector<glm::mat4>& transforms, bool skipTextures) {
+		drawModelInstanced(model, transforms.data(), transforms.size(), skipTextures);
+	}
+
+
+	void bindTexture(const Texture& texture, int unit, std::string name) {
+		shaderLoadInt(name.c_str(), unit);
+		bindTexture2D(unit, getBindableTexture(texture));
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Model (a collection of meshes)
+	//---------------------------------------------------------------
+
+	// CPU side result of an import, produced without touching GL
+	struct MeshDataLOD {
+		uint32_t indiceCount;
+		float error;
+	};
+
+	struct MeshData {
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices; // The full mesh followed by the index ranges of lods
+		std::vector<unsigned int> images; // Indices into ModelData::images
+		std::vector<MeshDataLOD> lods;
+
+		// Set instead of the vectors when loaded from a mapped model cache
+		const Vertex* mappedVertices;
+		const unsigned int* mappedIndices;
+		size_t mappedVertexCount, mappedIndexCount;
+
+		const Vertex* vertexData() const { return mappedVertices ? mappedVertices : vertices.data(); }
+		const unsigned int* indexData() const { return mappedVertices ? mappedIndices : indices.data(); }
+		size_t vertexCount() const { return mappedVertices ? mappedVertexCount : vertices.size(); }
+		size_t indexCount() const { return mappedVertices ? mappedIndexCount : indices.size(); }
+		size_t fullIndexCount() const {
+			size_t count = indexCount();
+			for (const MeshDataLOD& lod : lods) {
+				count -= lod.indiceCount;
+			}
+			return count;
+		}
+
+		MeshData() : mappedVertices(nullptr), mappedIndices(nullptr), mappedVertexCount(0), mappedIndexCount(0) {}
+	};
+
+	struct MappedFile;
+
+	struct ModelData {
+		std::string sourcePath;
+		std::vector<MeshData> meshes;
+		std::vector<ImageData> images;
+		std::unordered_map<std::string, unsigned int> imageLookup; // Signature -> index into images
+
+		bool keepSources; // Keep embedded image bytes for writing the model cache
+		std::shared_ptr<MappedFile> mapping; // Backs the mapped mesh data
+
+		QuantizationBox bounds; // Of every mesh, shared geometry is quantized to it so one dequantization fits the model
+
+		ModelData() : keepSources(false), bounds{ glm::vec3(0.0f), glm::vec3(0.0f) } {}
+	};
+
+	void computeModelDataBounds(ModelData& modelData) {
+		bool first = true;
+		for (const MeshData& meshData : modelData.meshes) {
+			const Vertex* vertices = meshData.vertexData();
+			for (size_t i = 0; i < meshData.vertexCount(); ++i) {
+				modelData.bounds.minimum = first ? vertices[i].position : glm::min(modelData.bounds.minimum, vertices[i].position);
+				modelData.bounds.maximum = first ? vertices[i].position : glm::max(modelData.bounds.maximum, vertices[i].position);
+				first = false;
+			}
+		}
+	}
+
+	void freeModelData(ModelData& modelData) {
+		for (ImageData& image : modelData.images) {
+			freeImage(image);
+		}
+	}
+
+	void loadMaterialTextures(aiMaterial* mat, aiTextureType aiType, const TextureType& type, MeshData& meshData, ModelData& modelData, const aiScene* scene, const std::string& modelDirectory) {
+		for (unsigned int i = 0; i < mat->GetTextureCount(aiType); ++i) {
+			aiString path;
+			mat->GetTexture(aiType, i, &path);
+
+			// Embedded textures are referenced as "*<index>"
+			bool embedded = path.C_Str()[0] == '*';
+			const std::string signature = embedded ? path.C_Str() + modelData.sourcePath : modelDirectory + std::string(path.C_Str());
+
+			// Decode each image once per model
+			auto it = modelData.imageLookup.find(signature);
+			if (it != modelData.imageLookup.end()) {
+				meshData.images.push_back(it->second);
+				continue;
+			}
+
+			ImageData image;
+			bool decoded = false;
+			if (embedded) {
+				const aiTexture* texture = scene->mTextures[std::stoi(path.C_Str() + 1)];
+				const unsigned char* source = (const unsigned char*)texture->pcData;
+				decoded = decodeEmbeddedImage(image, source, texture->mWidth, texture->mHeight, type, signature);
+				if (decoded && modelData.keepSources) {
+					image.source.assign(source, source + getEmbeddedImageSize(texture->mWidth, texture->mHeight));
+				}
+			}
+			else {
+				decoded = decodeImageFile(image, signature, type);
+			}
+			if (!decoded) {
+				continue;
+			}
+
+			unsigned int imageIndex = (unsigned int)modelData.images.size();
+			modelData.images.push_back(image);
+			modelData.imageLookup[signature] = imageIndex;
+			meshData.images.push_back(imageIndex);
+		}
+	}
+
+	void processMesh(aiMesh* mesh, const aiScene* scene, const std::string& modelDirectory, ModelData& modelData) {
+		STDGL_CPU_ZONE("processMesh");
+
+		MeshData& meshData = modelData.meshes.emplace_back();
+		std::vector<Vertex>& vertices = meshData.vertices;
+		std::vector<unsigned int>& indices = meshData.indices;
+		
+		// Vertices
+		vertices.reserve(mesh->mNumVertices);
+		for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+			Vertex vertex = {
+				glm::vec3{ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z },
+				glm::vec3{ mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z },
+				mesh->mTextureCoords[0] ? glm::vec2{ mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y} : glm::vec2{0},
+			};  // Note: We currently only support 1 of the 8 possible texture coordinates available through Assimp
+
+		#if STDGL_VERTEX_TANGENT_COLOR
+			if (mesh->HasTangentsAndBitangents()) {
+				glm::vec3 tangent{ mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z };
+				glm::vec3 bitangent{ mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z };
+				float handedness = glm::dot(glm::cross(vertex.normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+				vertex.tangent = glm::vec4(tangent, handedness);
+			}
+			if (mesh->HasVertexColors(0)) {
+				vertex.color = glm::vec4{ mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b, mesh->mColors[0][i].a };
+			}
+		#endif
+
+			vertices.push_back(vertex);
+		}
+
+		// Indices
+		indices.reserve((size_t)mesh->mNumFaces * 3);
+		for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+			const aiFace& face = mesh->mFaces[i];
+			indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+		}
+
+		// Materials
+		if (mesh->mMaterialIndex >= 0) {
+			aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+			// TODO: Add support for more types
+			loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::DIFFUSE, meshData, modelData, scene, modelDirectory);
+			loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::SPECULAR, meshData, modelData, scene, modelDirectory);
+		}
+	}
+
+	void processNode(aiNode* node, const aiScene* scene, const std::string& modelDirectory, ModelData& modelData) {
+		STDGL_LOG_TRACE("Processing node");
+		for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+			STDGL_LOG_TRACE("Loading mesh");
+			processMesh(mesh, scene, modelDirectory, modelData);
+		}
+
+		for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+			processNode(node->mChildren[i], scene, modelDirectory, modelData);
+		}
+	}
+
+	//// Model cache
+	// Versioned binary snapshot of an import: interleaved vertices, indices, mesh ranges
+	// and image references (embedded images with their source bytes). Machine local, native endianness.
+	constexpr char MODEL_CACHE_MAGIC[8] = { 'S', 'T', 'D', 'G', 'L', 'M', 'D', 'L' };
+	constexpr uint32_t MODEL_CACHE_VERSION = 3;
+
+	enum ModelCacheFlags : uint32_t {
+		MODEL_CACHE_TANGENTS = 1 << 0, // Imported with generated tangents
+		MODEL_CACHE_OPTIMIZED = 1 << 1 // Meshes went through optimizeMesh
+	};
+
+	struct ModelCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexSize;
+		uint64_t sourceSize; // Invalidation
+		int64_t sourceTime; // Invalidation
+		uint32_t meshCount;
+		uint32_t imageCount;
+		uint64_t meshOffset; // ModelCacheMesh[meshCount]
+		uint64_t imageOffset; // ModelCacheImage[imageCount]
+		uint32_t flags; // ModelCacheFlags
+		uint32_t lodLevels; // ModelLoadOptions::lodLevels the cache was written with
+	};
+
+	struct ModelCacheMesh {
+		uint64_t vertexOffset, vertexCount;
+		uint64_t indexOffset, indexCount;
+		uint64_t imageRefOffset; // uint32_t[imageRefCount]
+		uint32_t imageRefCount;
+		uint32_t lodCount;
+		uint64_t lodOffset; // MeshDataLOD[lodCount]
+	};
+
+	struct ModelCacheImage {
+		uint64_t signatureOffset;
+		uint32_t signatureLength;
+		uint32_t type;
+		uint32_t embedded;
+		uint32_t sourceWidth, sourceHeight;
+		uint32_t padding;
+		uint64_t sourceOffset, sourceSize;
+	};
+
+	struct MappedFile {
+		const unsigned char* data;
+		size_t size;
+
+		#ifdef _WIN32
+		HANDLE file, mapping;
+		MappedFile() : data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+		#else
+		int descriptor;
+		MappedFile() : data(nullptr), size(0), descriptor(-1) {}
+		#endif
+
+		~MappedFile() {
+			#ifdef _WIN32
+			if (data) UnmapViewOfFile(data);
+			if (mapping) CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+			#else
+			if (data) munmap((void*)data, size);
+			if (descriptor >= 0) close(descriptor);
+			#endif
+		}
+	};
+
+	std::shared_ptr<MappedFile> mapFile(const std::string& path) {
+		std::shared_ptr<MappedFile> mappedFile = std::make_shared<MappedFile>();
+
+		#ifdef _WIN32
+		mappedFile->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (mappedFile->file == INVALID_HANDLE_VALUE) {
+			return nullptr;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(mappedFile->file, &size) || size.QuadPart == 0) {
+			return nullptr;
+		}
+		mappedFile->size = (size_t)size.QuadPart;
+		mappedFile->mapping = CreateFileMappingA(mappedFile->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappedFile->mapping == nullptr) {
+			return nullptr;
+		}
+		mappedFile->data = (const unsigned char*)MapViewOfFile(mappedFile->mapping, FILE_MAP_READ, 0, 0, 0);
+		#else
+		mappedFile->descriptor = open(path.c_str(), O_RDONLY);
+		if (mappedFile->descriptor < 0) {
+			return nullptr;
+		}
+		struct stat status;
+		if (fstat(mappedFile->descriptor, &status) != 0 || status.st_size == 0) {
+			return nullptr;
+		}
+		mappedFile->size = (size_t)status.st_size;
+		void* data = mmap(nullptr, mappedFile->size, PROT_READ, MAP_PRIVATE, mappedFile->descriptor, 0);
+		mappedFile->data = data == MAP_FAILED ? nullptr : (const unsigned char*)data;
+		#endif
+
+		if (mappedFile->data == nullptr) {
+			return nullptr;
+		}
+		return mappedFile;
+	}
+
+	// Next to the source, or keyed by the path hash inside the cache directory
+	std::string getModelCachePath(const std::string& path) {
+		if (g_cacheDirectory.empty()) {
+			return path + ".stdglmodel";
+		}
+		char name[32];
+		std::snprintf(name, sizeof(name), "%08x.stdglmodel", hashStr(path.c_str(), path.size(), 0));
+		return (std::filesystem::path(g_cacheDirectory) / name).string();
+	}
+
+	bool getSourceStamp(const std::string& path, uint64_t& size, int64_t& time) {
+		std::error_code error;
+		size = (uint64_t)std::filesystem::file_size(path, error);
+		if (error) {
+			return false;
+		}
+		time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		return !error;
+	}
+
+	size_t appendCacheBytes(std::vector<unsigned char>& blob, const void* data, size_t size) {
+		size_t offset = (blob.size() + 15) & ~(size_t)15;
+		blob.resize(offset + size);
+		if (size > 0) {
+			std::memcpy(blob.data() + offset, data, size);
+		}
+		return offset;
+	}
+
+	void writeModelCache(const std::string& path, const ModelData& modelData, uint32_t flags, uint32_t lodLevels) {
+		ModelCacheHeader header = {};
+		header.flags = flags;
+		header.lodLevels = lodLevels;
+		if (!getSourceStamp(path, header.sourceSize, header.sourceTime)) {
+			return;
+		}
+		std::memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+		header.version = MODEL_CACHE_VERSION;
+		header.vertexSize = sizeof(Vertex);
+		header.meshCount = (uint32_t)modelData.meshes.size();
+		header.imageCount = (uint32_t)modelData.images.size();
+
+		std::vector<unsigned char> blob(sizeof(ModelCacheHeader));
+
+		std::vector<ModelCacheMesh> meshes;
+		for (const MeshData& meshData : modelData.meshes) {
+			ModelCacheMesh mesh = {};
+			mesh.vertexCount = meshData.vertexCount();
+			mesh.vertexOffset = appendCacheBytes(blob, meshData.vertexData(), meshData.vertexCount() * sizeof(Vertex));
+			mesh.indexCount = meshData.indexCount();
+			mesh.indexOffset = appendCacheBytes(blob, meshData.indexData(), meshData.indexCount() * sizeof(unsigned int));
+			mesh.imageRefCount = (uint32_t)meshData.images.size();
+			mesh.imageRefOffset = appendCacheBytes(blob, meshData.images.data(), meshData.images.size() * sizeof(unsigned int));
+			mesh.lodCount = (uint32_t)meshData.lods.size();
+			mesh.lodOffset = appendCacheBytes(blob, meshData.lods.data(), meshData.lods.size() * sizeof(MeshDataLOD));
+			meshes.push_back(mesh);
+		}
+
+		std::vector<ModelCacheImage> images;
+		for (const ImageData& imageData : modelData.images) {
+			ModelCacheImage image = {};
+			image.signatureLength = (uint32_t)imageData.signature.size();
+			image.signatureOffset = appendCacheBytes(blob, imageData.signature.data(), imageData.signature.size());
+			image.type = (uint32_t)imageData.type;
+			image.embedded = imageData.embedded;
+			if (imageData.embedded) {
+				if (imageData.source.empty()) {
+					return; // Source bytes were not kept, the cache would be incomplete
+				}
+				image.sourceWidth = imageData.sourceWidth;
+				image.sourceHeight = imageData.sourceHeight;
+				image.sourceSize = imageData.source.size();
+				image.sourceOffset = appendCacheBytes(blob, imageData.source.data(), imageData.source.size());
+			}
+			images.push_back(image);
+		}
+
+		header.meshOffset = appendCacheBytes(blob, meshes.data(), meshes.size() * sizeof(ModelCacheMesh));
+		header.imageOffset = appendCacheBytes(blob, images.data(), images.size() * sizeof(ModelCacheImage));
+		std::memcpy(blob.data(), &header, sizeof(header));
+
+		// Write then rename, readers never see a partial file. Each writer has its own temporary file,
+		// concurrent loads of the same model (threads or processes) would otherwise interleave their bytes
+		const std::string cachePath = getModelCachePath(path);
+		char suffix[64];
+		std::snprintf(suffix, sizeof(suffix), ".%zx.%llx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()), (unsigned long long)getProfilerTimestamp());
+		const std::string temporaryPath = cachePath + suffix;
+		createCacheDirectory();
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.write((const char*)blob.data(), blob.size())) {
+				STDGL_LOG_ERROR_F("Failed to write model cache: {}", cachePath);
+				file.close();
+				std::error_code error;
+				std::filesystem::remove(temporaryPath, error);
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, cachePath, error);
+		if (error) {
+			STDGL_LOG_ERROR_F("Failed to write model cache: {}", cachePath);
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+		STDGL_LOG_DEBUG_F("Wrote model cache: {}", cachePath);
+	}
+
+	// Caches missing any of the required flags or with other LOD levels are stale
+	bool readModelCache(const std::string& path, ModelData& modelData, uint32_t requiredFlags, uint32_t lodLevels) {
+		const std::string cachePath = getModelCachePath(path);
+		std::shared_ptr<MappedFile> mappedFile = mapFile(cachePath);
+		if (!mappedFile || mappedFile->size < sizeof(ModelCacheHeader)) {
+			return false;
+		}
+
+		const unsigned char* data = mappedFile->data;
+		const size_t size = mappedFile->size;
+		// count elements of elementSize bytes at offset, written to not overflow on corrupt counts
+		auto inRange = [size](uint64_t offset, uint64_t count, uint64_t elementSize) { return offset <= size && count <= (size - offset) / elementSize; };
+
+		ModelCacheHeader header;
+		std::memcpy(&header, data, sizeof(header));
+
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if (std::memcmp(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != MODEL_CACHE_VERSION
+			|| header.vertexSize != sizeof(Vertex)
+			|| (header.flags & requiredFlags) != requiredFlags
+			|| header.lodLevels != lodLevels
+			|| !getSourceStamp(path, sourceSize, sourceTime)
+			|| header.sourceSize != sourceSize
+			|| header.sourceTime != sourceTime) {
+			STDGL_LOG_DEBUG_F("Model cache is stale: {}", cachePath);
+			return false;
+		}
+
+		if (!inRange(header.meshOffset, header.meshCount, sizeof(ModelCacheMesh))
+			|| !inRange(header.imageOffset, header.imageCount, sizeof(ModelCacheImage))) {
+			return false;
+		}
+		const ModelCacheMesh* meshes = (const ModelCacheMesh*)(data + header.meshOffset);
+		const ModelCacheImage* images = (const ModelCacheImage*)(data + header.imageOffset);
+
+		modelData.sourcePath = path;
+		modelData.mapping = mappedFile;
+
+		for (uint32_t i = 0; i < header.imageCount; ++i) {
+			const ModelCacheImage& image = images[i];
+			if (!inRange(image.signatureOffset, image.signatureLength, 1) || (image.embedded && !inRange(image.sourceOffset, image.sourceSize, 1))) {
+				return false;
+			}
+			const std::string signature((const char*)data + image.signatureOffset, image.signatureLength);
+			const TextureType type = (TextureType)image.type;
+
+			ImageData imageData;
+			bool decoded = image.embedded
+				? decodeEmbeddedImage(imageData, data + image.sourceOffset, image.sourceWidth, image.sourceHeight, type, signature)
+				: decodeImageFile(imageData, signature, type);
+			modelData.images.push_back(imageData);
+			if (!decoded) {
+				return false;
+			}
+		}
+
+		for (uint32_t i = 0; i < header.meshCount; ++i) {
+			const ModelCacheMesh& mesh = meshes[i];
+			if (!inRange(mesh.vertexOffset, mesh.vertexCount, sizeof(Vertex))
+				|| !inRange(mesh.indexOffset, mesh.indexCount, sizeof(unsigned int))
+				|| !inRange(mesh.imageRefOffset, mesh.imageRefCount, sizeof(unsigned int))
+				|| !inRange(mesh.lodOffset, mesh.lodCount, sizeof(MeshDataLOD))) {
+				return false;
+			}
+
+			MeshData& meshData = modelData.meshes.emplace_back();
+			meshData.mappedVertices = (const Vertex*)(data + mesh.vertexOffset);
+			meshData.mappedVertexCount = mesh.vertexCount;
+			meshData.mappedIndices = (const unsigned int*)(data + mesh.indexOffset);
+			meshData.mappedIndexCount = mesh.indexCount;
+
+			const unsigned int* imageRefs = (const unsigned int*)(data + mesh.imageRefOffset);
+			for (uint32_t j = 0; j < mesh.imageRefCount; ++j) {
+				if (imageRefs[j] >= header.imageCount) {
+					return false;
+				}
+				meshData.images.push_back(imageRefs[j]);
+			}
+
+			const MeshDataLOD* lods = (const MeshDataLOD*)(data + mesh.lodOffset);
+			uint64_t lodIndexCount = 0;
+			for (uint32_t j = 0; j < mesh.lodCount; ++j) {
+				lodIndexCount += lods[j].indiceCount;
+				meshData.lods.push_back(lods[j]);
+			}
+			if (lodIndexCount > mesh.indexCount) {
+				return false;
+			}
+		}
+
+		STDGL_LOG_DEBUG_F("Loaded model cache: {}", cachePath);
+		return true;
+	}
+
+	// Index count of each generated LOD relative to the previous level
+	#ifndef STDGL_LOD_REDUCTION
+	#define STDGL_LOD_REDUCTION 0.5f
+	#endif
+
+	// Appends the simplified levels to the mesh indices, stops early once simplification stalls
+	void generateMeshLODs(MeshData& meshData, unsigned int levels) {
+		if (levels == 0) {
+			return;
+		}
+
+		// Collapses are decided on the first vertex of each position, so vertices split only by their
+		// normal or UV are not locked as seams and the coarse levels can collapse across them
+		const std::vector<Vertex>& vertices = meshData.vertices;
+		std::vector<unsigned int> positionGroup;
+		groupVerticesByPosition(vertices, positionGroup);
+		std::vector<unsigned int> weldedIndices(meshData.indices.size());
+		for (size_t i = 0; i < weldedIndices.size(); ++i) {
+			weldedIndices[i] = positionGroup[meshData.indices[i]];
+		}
+
+		// Vertices of each position group, groupOffsets is indexed by the group's first vertex
+		std::vector<unsigned int> groupOffsets(vertices.size() + 1, 0), groupVertices(vertices.size());
+		for (unsigned int group : positionGroup) {
+			++groupOffsets[group + 1];
+		}
+		for (size_t i = 0; i < vertices.size(); ++i) {
+			groupOffsets[i + 1] += groupOffsets[i];
+		}
+		{
+			std::vector<unsigned int> fill(groupOffsets.begin(), groupOffsets.end() - 1);
+			for (size_t i = 0; i < vertices.size(); ++i) {
+				groupVertices[fill[positionGroup[i]]++] = (unsigned int)i;
+			}
+		}
+
+		// Levels index the original vertices: a corner keeps its own vertex while its position survives,
+		// a collapsed corner takes the vertex of its new position with the closest normal and UV
+		auto restoreAttributes = [&](std::vector<unsigned int>& lodIndices, const std::vector<unsigned int>& sourceTriangles) {
+			for (size_t i = 0; i < lodIndices.size(); ++i) {
+				const unsigned int original = meshData.indices[sourceTriangles[i / 3] * 3 + i % 3];
+				const unsigned int group = lodIndices[i];
+				if (positionGroup[original] == group) {
+					lodIndices[i] = original;
+					continue;
+				}
+
+				float bestDistance = std::numeric_limits<float>::max();
+				for (unsigned int j = groupOffsets[group]; j < groupOffsets[group + 1]; ++j) {
+					const Vertex& candidate = vertices[groupVertices[j]];
+					const glm::vec2 uvDelta = candidate.textureCoordinate - vertices[original].textureCoordinate;
+					const float distance = glm::dot(uvDelta, uvDelta) + (1.0f - glm::dot(candidate.normal, vertices[original].normal));
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						lodIndices[i] = groupVertices[j];
+					}
+				}
+			}
+		};
+
+		size_t indexCount = meshData.indices.size();
+		for (unsigned int level = 0; level < levels; ++level) {
+			size_t target = (size_t)(indexCount * STDGL_LOD_REDUCTION) / 3 * 3;
+			if (target < 3) {
+				break;
+			}
+
+			// Simplify from the full mesh every time, errors do not compound
+			float error = 0.0f;
+			std::vector<unsigned int> sourceTriangles;
+			std::vector<unsigned int> lodIndices = simplifyMeshInternal(vertices, weldedIndices, target, &error, &sourceTriangles);
+			if (lodIndices.empty() || lodIndices.size() > indexCount * 9 / 10) {
+				break;
+			}
+			restoreAttributes(lodIndices, sourceTriangles);
+			optimizeVertexCache(lodIndices, meshData.vertices.size());
+
+			meshData.indices.insert(meshData.indices.end(), lodIndices.begin(), lodIndices.end());
+			meshData.lods.push_back({ (uint32_t)lodIndices.size(), error });
+			indexCount = lodIndices.size();
+		}
+	}
+
+	// Import, vertex conversion and image decode, safe to run on a worker thread
+	bool importModel(const std::string& path, ModelData& modelData, const ModelLoadOptions& options) {
+		STDGL_CPU_ZONE("importModel");
+
+	#if STDGL_VERTEX_TANGENT_COLOR
+		const bool tangents = options.vertexFormat.tangent != VertexAttributeFormat::NONE;
+	#else
+		const bool tangents = false;
+		if (options.vertexFormat.tangent != VertexAttributeFormat::NONE || options.vertexFormat.color != VertexAttributeFormat::NONE) {
+			STDGL_LOG_ERROR_F("Importing tangents and colors needs STDGL_VERTEX_TANGENT_COLOR, {} gets the defaults", path);
+		}
+	#endif
+		const uint32_t cacheFlags = (tangents ? (uint32_t)MODEL_CACHE_TANGENTS : 0u) | (options.optimizeMeshes ? (uint32_t)MODEL_CACHE_OPTIMIZED : 0u);
+
+		if (options.useCache) {
+			if (readModelCache(path, modelData, cacheFlags, options.lodLevels)) {
+				computeModelDataBounds(modelData);
+				return true;
+			}
+			// Start over from the source
+			freeModelData(modelData);
+			modelData = ModelData();
+			modelData.keepSources = true;
+		}
+
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | (tangents ? aiProcess_CalcTangentSpace : 0));
+
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+			STDGL_LOG_ERROR_F("Assimp error: {}", importer.GetErrorString());
+			return false;
+		}
+
+		const std::string modelDirectory = path.substr(0, path.find_last_of('/')+1);
+
+		modelData.sourcePath = path;
+		processNode(scene->mRootNode, scene, modelDirectory, modelData);
+
+		if (options.optimizeMeshes) {
+			for (size_t i = 0; i < modelData.meshes.size(); ++i) {
+				MeshData& meshData = modelData.meshes[i];
+				MeshOptimizationStats stats = optimizeMesh(meshData.vertices, meshData.indices);
+				STDGL_LOG_DEBUG_F("Optimized mesh {} of {}: vertices {} -> {}, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+					i, path, stats.verticesBefore, stats.verticesAfter, stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr);
+				(void)stats; // Unused without STDGL_LOG
+			}
+		}
+
+		for (MeshData& meshData : modelData.meshes) {
+			generateMeshLODs(meshData, options.lodLevels);
+		}
+
+		if (options.useCache) {
+			writeModelCache(path, modelData, cacheFlags, options.lodLevels);
+		}
+		computeModelDataBounds(modelData);
+		return true;
+	}
+
+	Mesh uploadMeshData(const MeshData& meshData, const ModelData& modelData, const std::vector<Texture>& images, const ModelLoadOptions& options) {
+		std::vector<Texture> textures;
+		textures.reserve(meshData.images.size());
+		for (unsigned int image : meshData.images) {
+			textures.push_back(images[image]);
+		}
+
+		// TODO: Extract native primitive mode and remove post-processing effect
+		Mesh mesh = options.sharedGeometry
+			? uploadSharedMesh(GL_TRIANGLES, meshData.vertexData(), meshData.vertexCount(), meshData.indexData(), meshData.indexCount(), textures, options.vertexFormat, &modelData.bounds)
+			: uploadElementMesh(GL_TRIANGLES, meshData.vertexData(), meshData.vertexCount(), meshData.indexData(), meshData.indexCount(), textures, options.vertexFormat);
+		keepGeometry(mesh, meshData.vertexData(), meshData.vertexCount(), meshData.indexData(), meshData.indexCount());
+
+		// The levels follow the full mesh in the uploaded indices
+		const size_t fullIndexCount = meshData.fullIndexCount();
+		GLuint firstIndex = mesh.firstIndex + (GLuint)fullIndexCount;
+		for (const MeshDataLOD& lod : meshData.lods) {
+			mesh.lods.push_back({ firstIndex, (GLsizei)lod.indiceCount, lod.error });
+			firstIndex += lod.indiceCount;
+		}
+		mesh.indiceCount = (GLsizei)fullIndexCount;
+		if (!mesh.indices.empty()) {
+			mesh.indices.resize(fullIndexCount);
+		}
+		return mesh;
+	}
+
+	void fillModelBounds(ModelBounds& bounds, const std::vector<Mesh>& meshes) {
+		const size_t padded = (meshes.size() + 3) & ~(size_t)3;
+		for (std::vector<float>* component : { &bounds.centerX, &bounds.centerY, &bounds.centerZ, &bounds.extentX, &bounds.extentY, &bounds.extentZ }) {
+			component->assign(padded, 0.0f);
+		}
+
+		for (size_t i = 0; i < meshes.size(); ++i) {
+			glm::vec3 center = (meshes[i].boundsMin + meshes[i].boundsMax) * 0.5f;
+			glm::vec3 extent = (meshes[i].boundsMax - meshes[i].boundsMin) * 0.5f;
+			bounds.centerX[i] = center.x;
+			bounds.centerY[i] = center.y;
+			bounds.centerZ[i] = center.z;
+			bounds.extentX[i] = extent.x;
+			bounds.extentY[i] = extent.y;
+			bounds.extentZ[i] = extent.z;
+		}
+		bounds.count = meshes.size();
+	}
+
+	void updateModelBounds(Model& model) {
+		fillModelBounds(model.bounds, model.meshes);
+	}
+
+	//// Lifetime
+	struct ModelRecord {
+		std::vector<ResourceHandle> meshes; // The model holds the only reference of its meshes
+	};
+
+	static ResourcePool<ModelRecord> g_modelPool;
+
+	// Hands out the handle and drops the references the loader took on the images, the meshes hold their own
+	void registerModel(Model& model, const std::vector<Texture>& images) {
+		ModelRecord record;
+		record.meshes.reserve(model.meshes.size());
+		for (const Mesh& mesh : model.meshes) {
+			record.meshes.push_back(mesh.handle);
+		}
+		model.handle = g_modelPool.create(std::move(record));
+
+		for (const Texture& image : images) {
+			releaseTexture(image.handle);
+		}
+	}
+
+	void retainModel(const Model& model) {
+		auto* slot = g_modelPool.find(model.handle);
+		if (slot != nullptr) {
+			++slot->refCount;
+		}
+	}
+
+	void unloadModel(Model& model) {
+		auto* slot = g_modelPool.find(model.handle);
+		if (slot != nullptr) {
+			if (--slot->refCount == 0) {
+				for (ResourceHandle mesh : slot->resource.meshes) {
+					releaseMesh(mesh);
+				}
+				g_modelPool.destroy(model.handle);
+			}
+		}
+		else if (model.handle.generation == 0) {
+			for (Mesh& mesh : model.meshes) {
+				unloadMesh(mesh);
+			}
+		}
+		model = Model();
+	}
+
+	void destroyResources() {
+		g_modelPool = ResourcePool<ModelRecord>();
+		destroyMeshes();
+		destroyTextureCache();
+	}
+
+	std::optional<Model> loadModel(const std::string& path, const ModelLoadOptions& options) {
+		STDGL_CPU_ZONE("loadModel");
+
+		ModelData modelData;
+		if (!importModel(path, modelData, options)) {
+			freeModelData(modelData);
+			return {};
+		}
+
+		std::vector<Texture> images;
+		images.reserve(modelData.images.size());
+		for (ImageData& image : modelData.images) {
+			images.push_back(uploadImage(image));
+		}
+
+		std::vector<Mesh> meshes; // Mesh vector to populate
+		meshes.reserve(modelData.meshes.size());
+		for (const MeshData& meshData : modelData.meshes) {
+			meshes.push_back(uploadMeshData(meshData, modelData, images, options));
+		}
+
+		STDGL_LOG_DEBUG_F("Loaded model form: {}", path);
+		Model model{ meshes, path, {}, {} };
+		updateModelBounds(model);
+		registerModel(model, images);
+		return model;
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Async loading
+	//---------------------------------------------------------------
+
+	#ifndef STDGL_UPLOAD_BUDGET_MS
+	#define STDGL_UPLOAD_BUDGET_MS 2.0f
+	#endif
+
+	struct WorkerJob {
+		std::function<void()> run;
+		std::function<void()> cancel; // Called instead of run for jobs still queued when the pool stops
+	};
+
+	struct WorkerPoolData {
+		std::vector<std::thread> threads;
+		std::deque<WorkerJob> jobs;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping;
+
+		WorkerPoolData() : stopping(false) {}
+	};
+
+	static WorkerPoolData g_workerPool;
+
+	void workerLoop() {
+		while (true) {
+			WorkerJob job;
+			{
+				std::unique_lock<std::mutex> lock(g_workerPool.mutex);
+				g_workerPool.condition.wait(lock, [] { return g_workerPool.stopping || !g_workerPool.jobs.empty(); });
+				if (g_workerPool.stopping) {
+					return;
+				}
+				job = std::move(g_workerPool.jobs.front());
+				g_workerPool.jobs.pop_front();
+			}
+			job.run();
+		}
+	}
+
+	void submitJob(std::function<void()> run, std::function<void()> cancel) {
+		{
+			std::lock_guard<std::mutex> lock(g_workerPool.mutex);
+			if (g_workerPool.threads.empty()) {
+				unsigned int hardwareThreads = std::thread::hardware_concurrency();
+				unsigned int threadCount = hardwareThreads > 2 ? hardwareThreads - 1 : 1;
+				STDGL_LOG_DEBUG_F("Starting {} loader threads", threadCount);
+				for (unsigned int i = 0; i < threadCount; ++i) {
+					g_workerPool.threads.emplace_back(workerLoop);
+				}
+			}
+			g_workerPool.jobs.push_back({ std::move(run), std::move(cancel) });
+		}
+		g_workerPool.condition.notify_one();
+	}
+
+	// Imported models waiting for GL resources
+	struct PendingModelUpload {
+		std::shared_ptr<AsyncModel> target;
+		ModelLoadOptions options;
+		ModelData modelData;
+
+		std::vector<Texture> images; // Uploaded so far, indexed like modelData.images
+		std::vector<Mesh> meshes; // Uploaded so far
+	};
+
+	struct UploadQueueData {
+		std::mutex mutex;
+		std::deque<PendingModelUpload> imported; // Filled by workers
+		std::deque<PendingModelUpload> uploading; // GL thread only
+		float budgetMilliseconds;
+
+		UploadQueueData() : budgetMilliseconds(STDGL_UPLOAD_BUDGET_MS) {}
+	};
+
+	static UploadQueueData g_uploadQueue;
+
+	void stopWorkerPool() {
+		// Jobs no worker picked up yet are cancelled, their models must not stay LOADING forever
+		std::deque<WorkerJob> cancelled;
+		{
+			std::lock_guard<std::mutex> lock(g_workerPool.mutex);
+			g_workerPool.stopping = true;
+			cancelled.swap(g_workerPool.jobs);
+		}
+		g_workerPool.condition.notify_all();
+
+		for (WorkerJob& job : cancelled) {
+			if (job.cancel) {
+				job.cancel();
+			}
+		}
+
+		for (std::thread& thread : g_workerPool.threads) {
+			thread.join();
+		}
+		g_workerPool.threads.clear();
+		g_workerPool.stopping = false;
+
+		// Drop unfinished uploads
+		std::lock_guard<std::mutex> lock(g_uploadQueue.mutex);
+		for (std::deque<PendingModelUpload>* queue : { &g_uploadQueue.imported, &g_uploadQueue.uploading }) {
+			for (PendingModelUpload& upload : *queue) {
+				freeModelData(upload.modelData);
+				upload.target->state = LoadState::FAILED;
+			}
+			queue->clear();
+		}
+	}
+
+	std::shared_ptr<AsyncModel> loadModelAsync(const std::string& path, const ModelLoadOptions& options) {
+		std::shared_ptr<AsyncModel> asyncModel = std::make_shared<AsyncModel>();
+
+		submitJob([asyncModel, path, options]() {
+			PendingModelUpload upload;
+			upload.target = asyncModel;
+			upload.options = options;
+
+			bool imported = false;
+			try {
+				imported = importModel(path, upload.modelData, options);
+			}
+			catch (const std::exception& e) {
+				STDGL_LOG_ERROR_F("Failed to import {}: {}", path, e.what());
+			}
+
+			if (!imported) {
+				freeModelData(upload.modelData);
+				asyncModel->state = LoadState::FAILED;
+				return;
+			}
+
+			asyncModel->state = LoadState::UPLOADING;
+			std::lock_guard<std::mutex> lock(g_uploadQueue.mutex);
+			g_uploadQueue.imported.push_back(std::move(upload));
+		},
+		[asyncModel]() {
+			asyncModel->state = LoadState::FAILED;
+		});
+
+		return asyncModel;
+	}
+
+	void setUploadBudget(float milliseconds) {
+		g_uploadQueue.budgetMilliseconds = milliseconds;
+	}
+
+	void processUploads(float budgetMilliseconds) {
+		STDGL_CPU_ZONE("processUploads");
+
+		{
+			std::lock_guard<std::mutex> lock(g_uploadQueue.mutex);
+			while (!g_uploadQueue.imported.empty()) {
+				g_uploadQueue.uploading.push_back(std::move(g_uploadQueue.imported.front()));
+				g_uploadQueue.imported.pop_front();
+			}
+		}
+
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(budgetMilliseconds));
+
+		// One texture or mesh per step, at least one step per call so loading always progresses
+		bool first = true;
+		while (!g_uploadQueue.uploading.empty() && (first || Clock::now() < deadline)) {
+			first = false;
+
+			PendingModelUpload& upload = g_uploadQueue.uploading.front();
+			ModelData& modelData = upload.modelData;
+
+			if (upload.images.size() < modelData.images.size()) {
+				upload.images.push_back(uploadImage(modelData.images[upload.images.size()]));
+				continue;
+			}
+
+			if (upload.meshes.size() < modelData.meshes.size()) {
+				upload.meshes.push_back(uploadMeshData(modelData.meshes[upload.meshes.size()], modelData, upload.images, upload.options));
+				continue;
+			}
+
+			upload.target->model = Model{ std::move(upload.meshes), modelData.sourcePath, {}, {} };
+			updateModelBounds(upload.target->model);
+			registerModel(upload.target->model, upload.images);
+			upload.target->state = LoadState::READY;
+			STDGL_LOG_DEBUG_F("Loaded model form: {}", modelData.sourcePath);
+			g_uploadQueue.uploading.pop_front();
+		}
+	}
+
+
+	//---------------------------------------------------------------
+	// [SECTION] Scene
+	//---------------------------------------------------------------
+
+	#ifndef STDGL_SCENE_MARGIN
+	#define STDGL_SCENE_MARGIN 0.1f
+	#endif
+
+	#ifndef STDGL_SCENE_MODEL_UNIFORM
+	#define STDGL_SCENE_MODEL_UNIFORM "model"
+	#endif
+
+	float getSurfaceArea(const glm::vec3& minimum, const glm::vec3& maximum) {
+		glm::vec3 size = maximum - minimum;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// World bounds of the transformed mesh bounds (Arvo)
+	void transformBounds(const glm::vec3& minimum, const glm::vec3& maximum, const glm::mat4& transform, glm::vec3& resultMin, glm::vec3& resultMax) {
+		resultMin = resultMax = glm::vec3(transform[3]);
+		for (int column = 0; column < 3; ++column) {
+			glm::vec3 axis(transform[column]);
+			glm::vec3 a = axis * minimum[column];
+			glm::vec3 b = axis * maximum[column];
+			resultMin += glm::min(a, b);
+			resultMax += glm::max(a, b);
+		}
+	}
+
+	int allocateSceneNode(Scene& scene) {
+		if (scene.freeNode < 0) {
+			scene.nodes.emplace_back();
+			scene.nodes.back().height = -1;
+			return (int)scene.nodes.size() - 1;
+		}
+		int node = scene.freeNode;
+		scene.freeNode = scene.nodes[node].parent;
+		return node;
+	}
+
+	void freeSceneNode(Scene& scene, int node) {
+		scene.nodes[node].parent = scene.freeNode;
+		scene.nodes[node].height = -1;
+		scene.freeNode = node;
+	}
+
+	void updateSceneNode(Scene& scene, int node) {
+		SceneNode& sceneNode = scene.nodes[node];
+		const SceneNode& left = scene.nodes[sceneNode.children[0]];
+		const SceneNode& right = scene.nodes[sceneNode.children[1]];
+		sceneNode.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+		sceneNode.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+		sceneNode.height = 1 + std::max(left.height, right.height);
+	}
+
+	// Rotates the taller grandchild up when the children of node differ in height by more than one, returns the subtree root
+	int balanceSceneNode(Scene& scene, int a) {
+		std::vector<SceneNode>& nodes = scene.nodes;
+		if (nodes[a].children[0] < 0 || nodes[a].height < 2) {
+			return a;
+		}
+
+		const int b = nodes[a].children[0];
+		const int c = nodes[a].children[1];
+		const int balance = nodes[c].height - nodes[b].height;
+		if (balance >= -1 && balance <= 1) {
+			return a;
+		}
+
+		// Rotate the taller child up into a's place
+		const int up = balance > 1 ? c : b;
+		const int down = balance > 1 ? b : c;
+		const int f = nodes[up].children[0];
+		const int g = nodes[up].children[1];
+
+		nodes[up].children[0] = a;
+		nodes[up].parent = nodes[a].parent;
+		nodes[a].parent = up;
+		if (nodes[up].parent >= 0) {
+			SceneNode& parent = nodes[nodes[up].parent];
+			parent.children[parent.children[0] == a ? 0 : 1] = up;
+		}
+		else {
+			scene.root = up;
 		}
 
-		// Create texture
-		/*
-			// Create depth attachment
-			glGenRenderbuffers(1, &framebufferData.rbo);
-			glBindRenderbuffer(GL_RENDERBUFFER, framebufferData.rbo);
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, framebufferData.width, framebufferData.height);
-			glBindRenderbuffer(GL_RENDERBUFFER, 0);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, framebufferData.rbo);
+		// The taller grandchild stays under up, the other one replaces up under a
+		const int keep = nodes[f].height > nodes[g].height ? f : g;
+		const int move = keep == f ? g : f;
+		nodes[up].children[1] = keep;
+		nodes[a].children[0] = down;
+		nodes[a].children[1] = move;
+		nodes[move].parent = a;
+
+		updateSceneNode(scene, a);
+		updateSceneNode(scene, up);
+		return up;
+	}
 
-		framebufferData.depthTextureID = createTexture();
-		glBindTexture(GL_TEXTURE_2D, framebufferData.depthTextureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, framebufferData.width, framebufferData.height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, framebufferData.depthTextureID, 0);
+	void refitSceneAncestors(Scene& scene, int node) {
+		while (node >= 0) {
+			node = balanceSceneNode(scene, node);
+			updateSceneNode(scene, node);
+			node = scene.nodes[node].parent;
+		}
+	}
 
-		if (extraAttachment) {
-			// Create extra texture attchment
-			framebufferData.extraID = createTexture();
-			glBindTexture(GL_TEXTURE_2D, framebufferData.extraID);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, framebufferData.width, framebufferData.height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glBindTexture(GL_TEXTURE_2D, 0);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, framebufferData.extraID, 0);
+	void insertSceneLeaf(Scene& scene, int leaf) {
+		std::vector<SceneNode>& nodes = scene.nodes;
+		if (scene.root < 0) {
+			scene.root = leaf;
+			nodes[leaf].parent = -1;
+			return;
+		}
 
-			GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-			glDrawBuffers(2, buffers);
+		// Descend towards the cheapest sibling, cost is the area added to the tree
+		const glm::vec3 leafMin = nodes[leaf].boundsMin;
+		const glm::vec3 leafMax = nodes[leaf].boundsMax;
+		int index = scene.root;
+		while (nodes[index].children[0] >= 0) {
+			const float area = getSurfaceArea(nodes[index].boundsMin, nodes[index].boundsMax);
+			const float combinedArea = getSurfaceArea(glm::min(nodes[index].boundsMin, leafMin), glm::max(nodes[index].boundsMax, leafMax));
+
+			const float cost = 2.0f * combinedArea; // New parent here
+			const float inheritanceCost = 2.0f * (combinedArea - area); // Growth of every ancestor below this one
+
+			float childCosts[2];
+			for (int i = 0; i < 2; ++i) {
+				const SceneNode& child = nodes[nodes[index].children[i]];
+				float childArea = getSurfaceArea(glm::min(child.boundsMin, leafMin), glm::max(child.boundsMax, leafMax));
+				if (child.children[0] >= 0) {
+					childArea -= getSurfaceArea(child.boundsMin, child.boundsMax);
+				}
+				childCosts[i] = childArea + inheritanceCost;
+			}
+
+			if (cost < childCosts[0] && cost < childCosts[1]) {
+				break;
+			}
+			index = nodes[index].children[childCosts[0] < childCosts[1] ? 0 : 1];
+		}
+
+		const int sibling = index;
+		const int oldParent = nodes[sibling].parent;
+		const int newParent = allocateSceneNode(scene);
+
+		SceneNode& parentNode = scene.nodes[newParent]; // nodes may have reallocated
+		parentNode.parent = oldParent;
+		parentNode.children[0] = sibling;
+		parentNode.children[1] = leaf;
+		parentNode.object = INVALID_SCENE_OBJECT;
+		scene.nodes[sibling].parent = newParent;
+		scene.nodes[leaf].parent = newParent;
+
+		if (oldParent >= 0) {
+			SceneNode& grandparent = scene.nodes[oldParent];
+			grandparent.children[grandparent.children[0] == sibling ? 0 : 1] = newParent;
+		}
+		else {
+			scene.root = newParent;
+		}
+
+		refitSceneAncestors(scene, newParent);
+	}
+
+	void removeSceneLeaf(Scene& scene, int leaf) {
+		std::vector<SceneNode>& nodes = scene.nodes;
+		if (leaf == scene.root) {
+			scene.root = -1;
+			return;
+		}
+
+		// The sibling takes the place of the parent
+		const int parent = nodes[leaf].parent;
+		const int grandparent = nodes[parent].parent;
+		const int sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+		if (grandparent >= 0) {
+			SceneNode& grandparentNode = nodes[grandparent];
+			grandparentNode.children[grandparentNode.children[0] == parent ? 0 : 1] = sibling;
+			nodes[sibling].parent = grandparent;
+			freeSceneNode(scene, parent);
+			refitSceneAncestors(scene, grandparent);
+		}
+		else {
+			scene.root = sibling;
+			nodes[sibling].parent = -1;
+			freeSceneNode(scene, parent);
+		}
+	}
+
+	void setSceneLeafBounds(Scene& scene, SceneObjectID object) {
+		const SceneObject& sceneObject = scene.objects[object];
+		SceneNode& leaf = scene.nodes[sceneObject.node];
+		transformBounds(sceneObject.mesh->boundsMin, sceneObject.mesh->boundsMax, sceneObject.transform, leaf.boundsMin, leaf.boundsMax);
+		leaf.boundsMin -= glm::vec3(STDGL_SCENE_MARGIN);
+		leaf.boundsMax += glm::vec3(STDGL_SCENE_MARGIN);
+	}
+
+	SceneObjectID addSceneObject(Scene& scene, const Mesh& mesh, const glm::mat4& transform) {
+		SceneObjectID object;
+		if (scene.freeObject != INVALID_SCENE_OBJECT) {
+			object = scene.freeObject;
+			scene.freeObject = scene.objects[object].node;
+		}
+		else {
+			object = (SceneObjectID)scene.objects.size();
+			scene.objects.emplace_back();
+		}
+
+		const int leaf = allocateSceneNode(scene);
+		SceneNode& leafNode = scene.nodes[leaf];
+		leafNode.children[0] = leafNode.children[1] = -1;
+		leafNode.object = object;
+		leafNode.height = 0;
+
+		scene.objects[object] = { &mesh, transform, glm::inverse(transform), leaf, 0 };
+		setSceneLeafBounds(scene, object);
+		insertSceneLeaf(scene, leaf);
+		return object;
+	}
+
+	std::vector<SceneObjectID> addSceneModel(Scene& scene, const Model& model, const glm::mat4& transform) {
+		std::vector<SceneObjectID> objects;
+		objects.reserve(model.meshes.size());
+		for (const Mesh& mesh : model.meshes) {
+			objects.push_back(addSceneObject(scene, mesh, transform));
+		}
+		return objects;
+	}
+
+	void removeSceneObject(Scene& scene, SceneObjectID object) {
+		STDGL_ASSERT(object >= 0 && object < (SceneObjectID)scene.objects.size() && scene.objects[object].mesh != nullptr);
+
+		SceneObject& sceneObject = scene.objects[object];
+		removeSceneLeaf(scene, sceneObject.node);
+		freeSceneNode(scene, sceneObject.node);
+
+		sceneObject.mesh = nullptr;
+		sceneObject.node = scene.freeObject;
+		scene.freeObject = object;
+	}
+
+	void moveSceneObject(Scene& scene, SceneObjectID object, const glm::mat4& transform) {
+		STDGL_ASSERT(object >= 0 && object < (SceneObjectID)scene.objects.size() && scene.objects[object].mesh != nullptr);
+
+		SceneObject& sceneObject = scene.objects[object];
+		sceneObject.transform = transform;
+		sceneObject.inverseTransform = glm::inverse(transform);
+
+		// Still inside the enlarged bounds, the tree is unchanged
+		glm::vec3 boundsMin, boundsMax;
+		transformBounds(sceneObject.mesh->boundsMin, sceneObject.mesh->boundsMax, transform, boundsMin, boundsMax);
+		const SceneNode& leaf = scene.nodes[sceneObject.node];
+		if (glm::all(glm::greaterThanEqual(boundsMin, leaf.boundsMin)) && glm::all(glm::lessThanEqual(boundsMax, leaf.boundsMax))) {
+			return;
+		}
+
+		removeSceneLeaf(scene, sceneObject.node);
+		setSceneLeafBounds(scene, object);
+		insertSceneLeaf(scene, sceneObject.node);
+	}
+
+	enum class FrustumTest { OUTSIDE, INTERSECTS, INSIDE };
+
+	FrustumTest testFrustumBounds(const glm::vec4 planes[6], const glm::vec3& minimum, const glm::vec3& maximum) {
+		const glm::vec3 center = (minimum + maximum) * 0.5f;
+		const glm::vec3 extent = (maximum - minimum) * 0.5f;
+
+		FrustumTest result = FrustumTest::INSIDE;
+		for (int p = 0; p < 6; ++p) {
+			const glm::vec3 normal(planes[p]);
+			float distance = glm::dot(normal, center) + planes[p].w;
+			float radius = glm::dot(glm::abs(normal), extent);
+			if (distance + radius < 0.0f) {
+				return FrustumTest::OUTSIDE;
+			}
+			if (distance - radius < 0.0f) {
+				result = FrustumTest::INTERSECTS;
+			}
+		}
+		return result;
+	}
+
+	void collectSceneLeaves(const Scene& scene, int node, std::vector<SceneObjectID>& results) {
+		thread_local std::vector<int> stack;
+		stack.clear();
+		stack.push_back(node);
+		while (!stack.empty()) {
+			const SceneNode& sceneNode = scene.nodes[stack.back()];
+			stack.pop_back();
+			if (sceneNode.children[0] < 0) {
+				results.push_back(sceneNode.object);
+			}
+			else {
+				stack.push_back(sceneNode.children[0]);
+				stack.push_back(sceneNode.children[1]);
+			}
+		}
+	}
+
+	void querySceneFrustum(const Scene& scene, const glm::mat4& viewProjection, std::vector<SceneObjectID>& results) {
+		STDGL_CPU_ZONE("querySceneFrustum");
+
+		results.clear();
+		if (scene.root < 0) {
+			return;
+		}
+
+		glm::vec4 planes[6];
+		extractFrustumPlanes(viewProjection, planes);
+
+		std::vector<int> stack = { scene.root };
+		while (!stack.empty()) {
+			const int node = stack.back();
+			stack.pop_back();
+
+			const SceneNode& sceneNode = scene.nodes[node];
+			FrustumTest test = testFrustumBounds(planes, sceneNode.boundsMin, sceneNode.boundsMax);
+			if (test == FrustumTest::OUTSIDE) {
+				continue;
+			}
+			if (test == FrustumTest::INSIDE || sceneNode.children[0] < 0) {
+				collectSceneLeaves(scene, node, results); // No further plane tests below a contained node
+				continue;
+			}
+			stack.push_back(sceneNode.children[0]);
+			stack.push_back(sceneNode.children[1]);
+		}
+	}
+
+	// Slab test, returns the entry distance or a negative value on a miss
+	float intersectRayBounds(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& minimum, const glm::vec3& maximum, float maxDistance) {
+		glm::vec3 t0 = (minimum - origin) * inverseDirection;
+		glm::vec3 t1 = (maximum - origin) * inverseDirection;
+		glm::vec3 near = glm::min(t0, t1);
+		glm::vec3 far = glm::max(t0, t1);
+		float entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+		float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+		return entry <= exit ? entry : -1.0f;
+	}
+
+	// Moller-Trumbore, returns the distance or a negative value on a miss
+	float intersectRayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		const glm::vec3 edge1 = b - a;
+		const glm::vec3 edge2 = c - a;
+		const glm::vec3 p = glm::cross(direction, edge2);
+		const float determinant = glm::dot(edge1, p);
+		if (std::abs(determinant) < 1e-12f) {
+			return -1.0f;
+		}
+
+		const float inverseDeterminant = 1.0f / determinant;
+		const glm::vec3 s = origin - a;
+		const float u = glm::dot(s, p) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f) {
+			return -1.0f;
+		}
+		const glm::vec3 q = glm::cross(s, edge1);
+		const float v = glm::dot(direction, q) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f) {
+			return -1.0f;
+		}
+		return glm::dot(edge2, q) * inverseDeterminant;
+	}
+
+	// Nearest triangle hit in mesh space, the distance is the same in world space since the direction is transformed with the point
+	float intersectRayMesh(const Mesh& mesh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance) {
+		float nearest = -1.0f;
+		auto testTriangle = [&](unsigned int a, unsigned int b, unsigned int c) {
+			float distance = intersectRayTriangle(origin, direction, mesh.vertices[a].position, mesh.vertices[b].position, mesh.vertices[c].position);
+			if (distance >= 0.0f && distance <= maxDistance && (nearest < 0.0f || distance < nearest)) {
+				nearest = distance;
+			}
+		};
+
+		if (!mesh.indices.empty()) {
+			for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+				testTriangle(mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]);
+			}
+		}
+		else {
+			for (unsigned int i = 0; i + 2 < mesh.vertices.size(); i += 3) {
+				testTriangle(i, i + 1, i + 2);
+			}
+		}
+		return nearest;
+	}
+
+	bool raycastScene(const Scene& scene, const glm::vec3& origin, const glm::vec3& direction, SceneRayHit& hit, float maxDistance) {
+		STDGL_CPU_ZONE("raycastScene");
+
+		hit = { INVALID_SCENE_OBJECT, maxDistance, glm::vec3(0.0f) };
+		if (scene.root < 0) {
+			return false;
+		}
+
+		const glm::vec3 inverseDirection = 1.0f / direction;
+
+		std::vector<int> stack = { scene.root };
+		while (!stack.empty()) {
+			const SceneNode& sceneNode = scene.nodes[stack.back()];
+			stack.pop_back();
+
+			if (intersectRayBounds(origin, inverseDirection, sceneNode.boundsMin, sceneNode.boundsMax, hit.distance) < 0.0f) {
+				continue;
+			}
+
+			if (sceneNode.children[0] >= 0) {
+				stack.push_back(sceneNode.children[0]);
+				stack.push_back(sceneNode.children[1]);
+				continue;
+			}
+
+			const SceneObject& object = scene.objects[sceneNode.object];
+			const Mesh& mesh = *object.mesh;
+			const glm::vec3 meshOrigin = glm::vec3(object.inverseTransform * glm::vec4(origin, 1.0f));
+			const glm::vec3 meshDirection = glm::vec3(object.inverseTransform * glm::vec4(direction, 0.0f));
+
+			float distance;
+			if (!mesh.vertices.empty() && mesh.mode == GL_TRIANGLES) {
+				distance = intersectRayMesh(mesh, meshOrigin, meshDirection, hit.distance);
+			}
+			else {
+				// GPU only geometry, the mesh bounds are the best available
+				distance = intersectRayBounds(meshOrigin, 1.0f / meshDirection, mesh.boundsMin, mesh.boundsMax, hit.distance);
+			}
+
+			if (distance >= 0.0f && distance <= hit.distance) {
+				hit.object = sceneNode.object;
+				hit.distance = distance;
+			}
+		}
+
+		if (hit.object == INVALID_SCENE_OBJECT) {
+			return false;
+		}
+		hit.position = origin + direction * hit.distance;
+		return true;
+	}
+
+	void drawScene(const Scene& scene, bool skipTextures) {
+		STDGL_CPU_ZONE("drawScene");
+
+		const RenderContext& renderContext = g_stdglContext->renderContext;
+		if (!renderContext.camera) {
+			return;
+		}
+
+		thread_local std::vector<SceneObjectID> visible;
+		visible.clear();
+		if (!renderContext.frustumCulling) {
+			for (SceneObjectID object = 0; object < (SceneObjectID)scene.objects.size(); ++object) {
+				if (scene.objects[object].mesh != nullptr) {
+					visible.push_back(object);
+				}
+			}
+		}
+		else {
+			querySceneFrustum(scene, renderContext.viewProjection, visible);
+
+			// Free slots are not objects
+			unsigned int objectCount = 0;
+			for (const SceneObject& sceneObject : scene.objects) {
+				objectCount += sceneObject.mesh != nullptr ? 1 : 0;
+			}
+			g_culling.stats.testedMeshes += objectCount;
+			g_culling.stats.culledMeshes += objectCount - (unsigned int)visible.size();
+		}
+
+		if (renderContext.frustumCulling && hasDepthPyramid()) {
+			size_t kept = 0;
+			for (SceneObjectID object : visible) {
+				const SceneNode& sceneNode = scene.nodes[scene.objects[object].node];
+				if (!isOccluded(g_occlusion.viewProjection, sceneNode.boundsMin, sceneNode.boundsMax)) {
+					visible[kept++] = object;
+				}
+			}
+			g_culling.stats.occludedMeshes += (unsigned int)(visible.size() - kept);
+			visible.resize(kept);
 		}
-		*/
 
-		// Check completeness
-		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-		if (status != GL_FRAMEBUFFER_COMPLETE) {
-			STDGL_LOG_ERROR_F("Framebuffer is not complete! Status: {}", status);
+		if (renderContext.frustumCulling) {
+			g_culling.stats.visibleMeshes += (unsigned int)visible.size();
 		}
 
-		// Reset
-		framebufferData.hasUpdated = false;
+		UniformHandle<glm::mat4> modelUniform = getUniform<glm::mat4>(STDGL_SCENE_MODEL_UNIFORM);
+		for (SceneObjectID object : visible) {
+			const SceneObject& sceneObject = scene.objects[object];
+			if (modelUniform.isValid()) {
+				modelUniform.load(sceneObject.transform);
+			}
+			sceneObject.lod = selectMeshLOD(*sceneObject.mesh, sceneObject.transform, sceneObject.lod);
+			drawMeshLevel(*sceneObject.mesh, sceneObject.lod, skipTextures);
+		}
 	}
 
-	void destroyFramebuffer(FramebufferData& framebufferData) {
-		glDeleteFramebuffers(1, &framebufferData.framebufferID);
 
-		for (const auto& [type, typeAttachments] : framebufferData.attachments) {
-			for (const auto& [index, attachment] : typeAttachments) {
-				glDeleteTextures(1, &attachment.textureID);
-			}
-		}
+	//---------------------------------------------------------------
+	// [SECTION] Profiler
+	//---------------------------------------------------------------
 
-		framebufferData.attachments.clear();
-		framebufferData.framebufferID = 0;
-	}
+	struct GPUZoneRecord {
+		StdGLID id;
+		StdGLID parent;
+		int depth;
+		unsigned int beginQuery, endQuery; // Indices into the frame query pool
+	};
 
-	GLuint addAttachment(FramebufferAttachmentType type, unsigned int attachmentIndex) {
-		StdGLID id = getID("");
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
+	struct GPUProfilerFrame {
+		std::vector<GLuint> queries; // [0] frame start, [1] frame end
+		unsigned int usedQueries;
+		std::vector<GPUZoneRecord> zones;
+		bool submitted; // Queries issued and waiting for read back
 
-		GLuint textureID = createTexture();
+		GPUProfilerFrame() : usedQueries(0), submitted(false) {}
+	};
 
-		if (type == FramebufferAttachmentType::COLOR) {
-			framebufferData.attachments[type].emplace(attachmentIndex, FramebufferAttachment(textureID, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, GL_LINEAR, GL_LINEAR, GL_COLOR_ATTACHMENT0 + attachmentIndex));
+	struct GPUProfilerData {
+		bool enabled;
+		bool requestEnabled;
+		bool frameOpen;
+		unsigned int frameIndex;
+		GPUProfilerFrame frames[STDGL_GPU_PROFILER_FRAMES];
+
+		std::vector<int> zoneStack; // Record index per open zone, -1 when it was not recorded
+		std::unordered_map<StdGLID, std::string> names;
+
+		std::vector<GPUZoneResult> results;
+		float frameMilliseconds;
+
+		GPUProfilerData() : enabled(false), requestEnabled(false), frameOpen(false), frameIndex(0), frameMilliseconds(0.0f) {}
+	};
+
+	static GPUProfilerData g_gpuProfiler;
+
+	unsigned int issueTimestamp(GPUProfilerFrame& frame, bool issue = true) {
+		if (frame.usedQueries == frame.queries.size()) {
+			size_t oldSize = frame.queries.size();
+			frame.queries.resize(std::max<size_t>(16, oldSize * 2));
+			glGenQueries((GLsizei)(frame.queries.size() - oldSize), frame.queries.data() + oldSize);
 		}
-		else if (type == FramebufferAttachmentType::DEPTH) {
-			framebufferData.attachments[type].emplace(attachmentIndex, FramebufferAttachment(textureID, GL_DEPTH_COMPONENT32, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, GL_LINEAR, GL_LINEAR, GL_DEPTH_ATTACHMENT));
+		unsigned int index = frame.usedQueries++;
+		if (issue) {
+			glQueryCounter(frame.queries[index], GL_TIMESTAMP);
 		}
-		else if (type == FramebufferAttachmentType::COLOR_RED_INT) {
-			framebufferData.attachments[type].emplace(attachmentIndex, FramebufferAttachment(textureID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, GL_NEAREST, GL_NEAREST, GL_COLOR_ATTACHMENT0 + attachmentIndex));
+		return index;
+	}
+
+	// Never waits, a frame whose results are still pending is dropped
+	void resolveGPUFrame(GPUProfilerFrame& frame) {
+		if (!frame.submitted) {
+			return;
 		}
+		frame.submitted = false;
 
-		framebufferData.hasUpdated = true;
-		return textureID;
-	}
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available != GL_TRUE) {
+			return;
+		}
 
-	bool beginFramebuffer(const char* name, int width, int height, bool extraAttachment) {
-		StdGLID id = getID(name);
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
+		std::vector<GLuint64> timestamps(frame.usedQueries);
+		for (unsigned int i = 0; i < frame.usedQueries; ++i) {
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+		}
 
-		if (width == 0 || height == 0) {
-			width = g_stdglContext->renderContext.width;
-			height = g_stdglContext->renderContext.height;
+		GLuint64 frameStart = timestamps[0];
+		g_gpuProfiler.frameMilliseconds = (float)((double)(timestamps[1] - frameStart) / 1.0e6);
+
+		g_gpuProfiler.results.clear();
+		for (const GPUZoneRecord& zone : frame.zones) {
+			GPUZoneResult result;
+			result.id = zone.id;
+			result.parent = zone.parent;
+			result.name = g_gpuProfiler.names[zone.id].c_str();
+			result.depth = zone.depth;
+			result.startMilliseconds = (float)((double)(timestamps[zone.beginQuery] - frameStart) / 1.0e6);
+			result.milliseconds = (float)((double)(timestamps[zone.endQuery] - timestamps[zone.beginQuery]) / 1.0e6);
+			g_gpuProfiler.results.push_back(result);
 		}
+	}
 
-		if (width == 0 || height == 0) return false;
+	// Called from newFrame, closes the previous frame and reads back the oldest one
+	void newGPUProfilerFrame() {
+		GPUProfilerData& profiler = g_gpuProfiler;
 
-		if (framebufferData.width != width || framebufferData.height != height || framebufferData.hasUpdated) {
-			framebufferData.hasUpdated = false;
-			framebufferData.width = width;
-			framebufferData.height = height;
-			// Destroy existing framebuffer
-			if (framebufferData.framebufferID != 0) {
-				destroyFramebuffer(framebufferData);
+		if (profiler.frameOpen) {
+			GPUProfilerFrame& frame = profiler.frames[profiler.frameIndex];
+			// Zones left open are not recorded
+			while (!profiler.zoneStack.empty()) {
+				endGPUZone();
 			}
-			pushID(id);
-			return true;
+			glQueryCounter(frame.queries[1], GL_TIMESTAMP);
+			frame.submitted = true;
+			profiler.frameOpen = false;
 		}
-		return false;
-	}
+		profiler.zoneStack.clear();
 
-	void buildFramebuffer() {
-		StdGLID id = getID("");
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
-		initializeFramebuffer(framebufferData);
-		framebufferData.hasUpdated = false;
-	}
+		profiler.enabled = profiler.requestEnabled;
+		if (!profiler.enabled) {
+			return;
+		}
 
-	void endFramebuffer() {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		popID();
-	}
+		profiler.frameIndex = (profiler.frameIndex + 1) % STDGL_GPU_PROFILER_FRAMES;
+		GPUProfilerFrame& frame = profiler.frames[profiler.frameIndex];
+		resolveGPUFrame(frame);
 
-	bool useFramebuffer(const char* name) {
-		StdGLID id = getID(name);
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
+		frame.usedQueries = 0;
+		frame.zones.clear();
+		issueTimestamp(frame); // Start
+		issueTimestamp(frame, false); // End, issued when the frame closes
+		profiler.frameOpen = true;
+	}
 
-		if (framebufferData.framebufferID == 0) {
-			return false;
+	void destroyGPUProfiler() {
+		for (GPUProfilerFrame& frame : g_gpuProfiler.frames) {
+			if (!frame.queries.empty()) {
+				glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+			}
 		}
-
-		pushID(id);
-		glBindFramebuffer(GL_FRAMEBUFFER, framebufferData.framebufferID);
-		return true;
+		g_gpuProfiler = GPUProfilerData();
 	}
 
-	void stopFramebuffer() {
-		popID();
+	void setGPUProfiling(bool enabled) {
+		g_gpuProfiler.requestEnabled = enabled;
+	}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	bool isGPUProfiling() {
+		return g_gpuProfiler.enabled;
 	}
 
-	GLuint getFramebufferID() {
-		StdGLID id = getID("");
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
+	void beginGPUZone(const char* name) {
+		GPUProfilerData& profiler = g_gpuProfiler;
+		if (!profiler.frameOpen || g_stdglContext == nullptr) {
+			profiler.zoneStack.push_back(-1);
+			return;
+		}
 
-		return framebufferData.framebufferID;
-	}
+		GPUProfilerFrame& frame = profiler.frames[profiler.frameIndex];
 
-	GLuint getFramebufferTextureID(int attachmentIndex, FramebufferAttachmentType type) {
-		StdGLID id = getID("");
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
+		StdGLID parent = 0;
+		for (auto it = profiler.zoneStack.rbegin(); it != profiler.zoneStack.rend(); ++it) {
+			if (*it >= 0) {
+				parent = frame.zones[*it].id;
+				break;
+			}
+		}
 
-		return framebufferData.attachments[type].at(attachmentIndex).textureID;
-	}
+		// Zones hash their own path, the shared ID stack must resolve the same with profiling on or off
+		StdGLID id = getIDWithSeed(parent, name);
 
-	Vec2 getFramebufferSize() {
-		StdGLID id = getID("");
-		FramebufferData& framebufferData = g_framebufferDataMap[id];
+		if (profiler.names.find(id) == profiler.names.end()) {
+			profiler.names[id] = name;
+		}
 
-		return { framebufferData.width, framebufferData.height };
+		GPUZoneRecord zone;
+		zone.id = id;
+		zone.parent = parent;
+		zone.depth = (int)std::count_if(profiler.zoneStack.begin(), profiler.zoneStack.end(), [](int index) { return index >= 0; });
+		zone.beginQuery = issueTimestamp(frame);
+		zone.endQuery = zone.beginQuery;
+
+		profiler.zoneStack.push_back((int)frame.zones.size());
+		frame.zones.push_back(zone);
 	}
 
-	//---------------------------------------------------------------
-	// [SECTION] Renderer
-	//---------------------------------------------------------------
+	void endGPUZone() {
+		GPUProfilerData& profiler = g_gpuProfiler;
+		if (profiler.zoneStack.empty()) {
+			return;
+		}
 
-	void beginRender(std::shared_ptr<Camera> camera) {
-		// Bind the renderer
-		RenderContext& renderContext = g_stdglContext->renderContext;
-		if (renderContext.camera != camera) {
-			renderContext.camera = camera;
+		int index = profiler.zoneStack.back();
+		profiler.zoneStack.pop_back();
+		if (index < 0 || !profiler.frameOpen) {
+			return;
 		}
+
+		GPUProfilerFrame& frame = profiler.frames[profiler.frameIndex];
+		frame.zones[index].endQuery = issueTimestamp(frame);
 	}
 
-	void endRender() {
-		// Unbind the renderer
+	const std::vector<GPUZoneResult>& getGPUZones() {
+		return g_gpuProfiler.results;
 	}
 
-	void clearFramebuffer() {
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	float getGPUFrameTime() {
+		return g_gpuProfiler.frameMilliseconds;
 	}
 
-	void useCamera(std::shared_ptr<Camera> camera) {
-		if (g_stdglContext->renderContext.camera != camera) {
-			g_stdglContext->renderContext.camera = camera;
+	void showGPUProfiler(bool* open) {
+		if (!ImGui::Begin("GPU Profiler", open)) {
+			ImGui::End();
+			return;
+		}
+
+		ImGui::Text("Frame: %.3f ms", g_gpuProfiler.frameMilliseconds);
+		ImGui::Separator();
+
+		if (ImGui::BeginTable("GPU zones", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("Start (ms)");
+			ImGui::TableSetupColumn("Time (ms)");
+			ImGui::TableHeadersRow();
+
+			for (const GPUZoneResult& zone : g_gpuProfiler.results) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Indent(zone.depth * 12.0f + 1.0f);
+				ImGui::TextUnformatted(zone.name);
+				ImGui::Unindent(zone.depth * 12.0f + 1.0f);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", zone.startMilliseconds);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", zone.milliseconds);
+			}
+			ImGui::EndTable();
 		}
+
+		ImGui::End();
 	}
 
-	std::shared_ptr<Camera> getCamera() {
-		return g_stdglContext->renderContext.camera;
+
+	uint64_t getProfilerTimestamp() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
-	void setRendererSize(int width, int height) {
-		RenderContext& renderContext = g_stdglContext->renderContext;
+	#ifdef STDGL_PROFILE
+	static_assert((STDGL_CPU_PROFILER_EVENTS & (STDGL_CPU_PROFILER_EVENTS - 1)) == 0, "STDGL_CPU_PROFILER_EVENTS must be a power of two");
 
-		if (width < 0) width = 0;
-		if (height < 0) height = 0;
+	struct CPUZoneEvent {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
 
-		renderContext.width = width;
-		renderContext.height = height;
+	// Single producer ring, only the owning thread writes. head doubles as the sequence readers validate slots against
+	struct CPUZoneRing {
+		unsigned int threadIndex;
+		std::atomic<uint64_t> head;
+		std::unique_ptr<CPUZoneEvent[]> events;
 
-		if (renderContext.camera && width > 0 && height > 0) {
-			renderContext.camera->projection = renderContext.camera->generateProjection();
-		}
-	}
+		CPUZoneRing(unsigned int threadIndex) : threadIndex(threadIndex), head(0), events(new CPUZoneEvent[STDGL_CPU_PROFILER_EVENTS]) {}
+	};
 
-	void drawMesh(const Mesh& mesh, bool skipTextures) {
-		if (!skipTextures) {
-		// Load mesh textures
-			unsigned int diffuseCounter = 0;
-			unsigned int specularCounter = 0;
-			for (unsigned int i = 0; i < mesh.textures.size(); ++i) {
-				std::string name;
-				if (mesh.textures[i].type == TextureType::DIFFUSE) {
-					name = "texture_diffuse" + (++diffuseCounter);
-				}
-				else if (mesh.textures[i].type == TextureType::SPECULAR) {
-					name = "texture_specular" + (++specularCounter);
-				}
+	struct CPUProfilerData {
+		std::mutex ringMutex; // Only taken when a thread records its first zone and when a capture is written
+		std::vector<std::unique_ptr<CPUZoneRing>> rings;
 
-				glActiveTexture(GL_TEXTURE0 + i);
-				shaderLoadInt(name.c_str(), i);
-				glBindTexture(GL_TEXTURE_2D, mesh.textures[i].textureID);
-			}
-			glActiveTexture(GL_TEXTURE0);
-		}
-		
-		// Load vertex buffer and call draw command
-		glBindVertexArray(mesh.vao);
-		
-		if (mesh.type == MeshType::ArrayMesh) {
-			glDrawArrays(mesh.mode, 0, mesh.vertexCount);
+		std::atomic<bool> capturing;
+		std::string capturePath;
+		int captureFramesLeft;
+		uint64_t captureStart;
+		std::vector<uint64_t> captureHeads; // Ring heads when the capture started
+
+		CPUProfilerData() : capturing(false), captureFramesLeft(0), captureStart(0) {}
+	};
+
+	static CPUProfilerData g_cpuProfiler;
+
+	CPUZoneRing& getThreadRing() {
+		thread_local CPUZoneRing* ring = nullptr;
+		if (ring == nullptr) {
+			std::lock_guard<std::mutex> lock(g_cpuProfiler.ringMutex);
+			g_cpuProfiler.rings.push_back(std::make_unique<CPUZoneRing>((unsigned int)g_cpuProfiler.rings.size()));
+			ring = g_cpuProfiler.rings.back().get();
 		}
-		else if (mesh.type == MeshType::ElementMesh) {
-			glDrawElements(mesh.mode, mesh.indiceCount, GL_UNSIGNED_INT, 0);
+		return *ring;
+	}
+
+	void recordCPUZone(const char* name, uint64_t start, uint64_t end) {
+		// Zones outside a capture are never written out, threads that never record one keep no ring
+		if (!g_cpuProfiler.capturing.load(std::memory_order_relaxed)) {
+			return;
 		}
 
-		glBindVertexArray(0);
+		CPUZoneRing& ring = getThreadRing();
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		// Orders the slot write after the head store that made the previous zone visible, see writeCPUTrace
+		std::atomic_thread_fence(std::memory_order_release);
+		ring.events[head & (STDGL_CPU_PROFILER_EVENTS - 1)] = { name, start, end };
+		ring.head.store(head + 1, std::memory_order_release);
 	}
 
-	void drawModel(const Model& model, bool skipTextures) {
-		for (const Mesh& mesh : model.meshes) {
-			drawMesh(mesh, skipTextures);
+	void writeJSONString(std::ofstream& stream, const char* str) {
+		stream << '"';
+		for (; *str != '\0'; ++str) {
+			if (*str == '"' || *str == '\\') {
+				stream << '\\';
+			}
+			stream << *str;
 		}
+		stream << '"';
 	}
 
+	void writeCPUTrace() {
+		CPUProfilerData& profiler = g_cpuProfiler;
 
-	void bindTexture(const Texture& texture, int unit, std::string name) {
-		glActiveTexture(GL_TEXTURE0 + unit);
-		shaderLoadInt(name.c_str(), unit);
-		glBindTexture(GL_TEXTURE_2D, texture.textureID);
-		glActiveTexture(GL_TEXTURE0);
-	}
+		std::ofstream stream(profiler.capturePath, std::ios::trunc);
+		if (!stream) {
+			STDGL_LOG_ERROR_F("Failed to write CPU trace: {}", profiler.capturePath);
+			return;
+		}
 
+		stream << std::fixed << std::setprecision(3); // Microseconds with nanosecond digits
+		stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		size_t eventCount = 0;
 
-	//---------------------------------------------------------------
-	// [SECTION] Model (a collection of meshes)
-	//---------------------------------------------------------------
+		std::lock_guard<std::mutex> lock(profiler.ringMutex);
+		for (size_t r = 0; r < profiler.rings.size(); ++r) {
+			CPUZoneRing& ring = *profiler.rings[r];
 
-	void loadMaterialTextures(aiMaterial* mat, aiTextureType aiType, const TextureType& type, std::vector<Texture>& textures, const aiScene* scene, const std::string& modelDirectory, const std::string& sourcePath) {
-		for (unsigned int i = 0; i < mat->GetTextureCount(aiType); ++i) {
-			aiString path;
-			mat->GetTexture(aiType, i, &path);
+			stream << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring.threadIndex
+				<< ",\"args\":{\"name\":\"Thread " << ring.threadIndex << "\"}}";
+			first = false;
 
-			// Check if texture is embedded
-			if (path.C_Str()[0] != '*') {
-				textures.push_back(loadTexture(modelDirectory + std::string(path.C_Str()), type));
-				continue;
+			uint64_t head = ring.head.load(std::memory_order_acquire);
+			uint64_t begin = r < profiler.captureHeads.size() ? profiler.captureHeads[r] : 0;
+			if (head - begin >= STDGL_CPU_PROFILER_EVENTS) {
+				begin = head - STDGL_CPU_PROFILER_EVENTS + 1;
 			}
-			
-			// Texture is embedded
-			int texture = std::stoi(path.C_Str() + 1);
-			const std::string signature = '*' + std::to_string(i) + sourcePath;
-			textures.push_back(loadEmbeddedTexture(scene->mTextures[texture], type, signature));
-		}
-	}
 
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene, const std::string& modelDirectory, const std::string& sourcePath) {
-		
-		std::vector<Vertex> vertices;
-		std::vector<unsigned int> indices;
-		std::vector<Texture> textures;
-		
-		// Vertices
-		for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-			Vertex vertex = {
-				glm::vec3{ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z },
-				glm::vec3{ mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z },
-				mesh->mTextureCoords[0] ? glm::vec2{ mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y} : glm::vec2{0},
-			};  // Note: We currently only support 1 of the 8 possible texture coordinates available through Assimp
+			for (uint64_t i = begin; i < head; ++i) {
+				CPUZoneEvent event = ring.events[i & (STDGL_CPU_PROFILER_EVENTS - 1)];
 
-			vertices.push_back(vertex);
-		}
+				// Seqlock check: once head reaches i + STDGL_CPU_PROFILER_EVENTS the owning thread may be overwriting the slot
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (ring.head.load(std::memory_order_relaxed) - i >= STDGL_CPU_PROFILER_EVENTS) {
+					continue;
+				}
+				if (event.start < profiler.captureStart) {
+					continue;
+				}
 
-		// Indices
-		for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-			aiFace face = mesh->mFaces[i];
-			indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+				stream << ",{\"name\":";
+				writeJSONString(stream, event.name);
+				stream << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring.threadIndex
+					<< ",\"ts\":" << (double)(event.start - profiler.captureStart) / 1000.0
+					<< ",\"dur\":" << (double)(event.end - event.start) / 1000.0 << "}";
+				++eventCount;
+			}
 		}
 
-		// Materials
-		if (mesh->mMaterialIndex >= 0) {
-			aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-			// TODO: Add support for more types
-			loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::DIFFUSE, textures, scene, modelDirectory, sourcePath);
-			loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::SPECULAR, textures, scene, modelDirectory, sourcePath);
-		}
-		
-		return loadMesh(GL_TRIANGLES, vertices, indices, textures); // TODO: Extract native primitive mode and remove post-processing effect
+		stream << "]}";
+		STDGL_LOG_DEBUG_F("CPU trace written: {} ({} zones)", profiler.capturePath, eventCount);
 	}
 
-	void processNode(aiNode* node, const aiScene* scene, std::vector<Mesh>& meshes, const std::string& modelDirectory, const std::string& sourcePath) {
-		STDGL_LOG_TRACE("Processing node");
-		for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			STDGL_LOG_TRACE("Loading mesh");
-			meshes.push_back(processMesh(mesh, scene, modelDirectory, sourcePath));
+	bool captureCPUTrace(const std::string& path, int frames) {
+		CPUProfilerData& profiler = g_cpuProfiler;
+		if (profiler.capturing || frames <= 0) {
+			return false;
 		}
 
-		for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-			processNode(node->mChildren[i], scene, meshes, modelDirectory, sourcePath);
+		profiler.capturePath = path;
+		profiler.captureFramesLeft = frames;
+		profiler.captureStart = getProfilerTimestamp();
+		{
+			std::lock_guard<std::mutex> lock(profiler.ringMutex);
+			profiler.captureHeads.clear();
+			for (const auto& ring : profiler.rings) {
+				profiler.captureHeads.push_back(ring->head.load(std::memory_order_acquire));
+			}
 		}
+		profiler.capturing = true;
+		return true;
 	}
 
-	std::optional<Model> loadModel(const std::string& path) {
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+	bool isCapturingCPUTrace() {
+		return g_cpuProfiler.capturing;
+	}
 
-		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-			STDGL_LOG_ERROR_F("Assimp error: {}", importer.GetErrorString());
-			return {};
+	// Called from newFrame
+	void advanceCPUCapture() {
+		CPUProfilerData& profiler = g_cpuProfiler;
+		if (!profiler.capturing || --profiler.captureFramesLeft > 0) {
+			return;
 		}
-
-		const std::string modelDirectory = path.substr(0, path.find_last_of('/')+1);
-
-		std::vector<Mesh> meshes; // Mesh vector to populate
-
-		processNode(scene->mRootNode, scene, meshes, modelDirectory, path);
-
-		STDGL_LOG_DEBUG_F("Loaded model form: {}", path);
-		return Model{ meshes, path };
+		writeCPUTrace();
+		profiler.capturing = false;
 	}
+	#else
+	void recordCPUZone(const char* name, uint64_t start, uint64_t end) {}
+	bool captureCPUTrace(const std::string& path, int frames) { return false; }
+	bool isCapturingCPUTrace() { return false; }
+	void advanceCPUCapture() {}
+	#endif
 
 
 	//---------------------------------------------------------------
@@ -1159,21 +6822,58 @@ namespace stdgl {
 	//---------------------------------------------------------------
 
 	struct UtilityData {
-		float lastFrameTime; // Delta timer
+		uint64_t startTimestamp; // First newFrame, monotonic nanoseconds
+		uint64_t lastFrameTimestamp; // Delta timer, monotonic nanoseconds
 
 		float fps; // Last segements fps
 		float fpsCounter; // Current segments fps
 		float fpsTime; // Time in current segement
 
-		UtilityData() : lastFrameTime(), fps(), fpsCounter(), fpsTime() {}
+		float frameTimes[STDGL_FRAME_HISTORY]; // Milliseconds, ring buffer
+		unsigned int frameTimeIndex; // Next write
+		unsigned int frameTimeCount;
+
+		UtilityData() : startTimestamp(), lastFrameTimestamp(), fps(), fpsCounter(), fpsTime(), frameTimes(), frameTimeIndex(), frameTimeCount() {}
 	};
 
 	static UtilityData g_utilityData;
 
 	Timestep newFrame() {
-		float currentTime = glfwGetTime();
-		float delta = currentTime - g_utilityData.lastFrameTime;
-		g_utilityData.lastFrameTime = currentTime;
+		advanceCPUCapture();
+		STDGL_CPU_ZONE("newFrame");
+
+		processUploads(g_uploadQueue.budgetMilliseconds);
+		processTextureStreaming();
+		pollShaderCompiles();
+		newGPUProfilerFrame();
+		newCullingFrame();
+		newUniformFrame();
+
+		if (g_stdglContext != nullptr) {
+			StateCache& cache = g_stdglContext->stateCache;
+			cache.lastIssuedCalls = cache.issuedCalls;
+			cache.lastElidedCalls = cache.elidedCalls;
+			cache.issuedCalls = 0;
+			cache.elidedCalls = 0;
+		}
+
+		// steady_clock, glfwGetTime has no timer without glfwInit (EGL headless)
+		uint64_t timestamp = getProfilerTimestamp();
+		if (g_utilityData.startTimestamp == 0) {
+			g_utilityData.startTimestamp = timestamp;
+		}
+		float currentTime = (float)((double)(timestamp - g_utilityData.startTimestamp) / 1.0e9);
+
+		float delta = currentTime;
+		if (g_utilityData.lastFrameTimestamp != 0) {
+			double milliseconds = (double)(timestamp - g_utilityData.lastFrameTimestamp) / 1.0e6;
+			delta = (float)(milliseconds / 1000.0);
+
+			g_utilityData.frameTimes[g_utilityData.frameTimeIndex] = (float)milliseconds;
+			g_utilityData.frameTimeIndex = (g_utilityData.frameTimeIndex + 1) % STDGL_FRAME_HISTORY;
+			g_utilityData.frameTimeCount = std::min(g_utilityData.frameTimeCount + 1, (unsigned int)STDGL_FRAME_HISTORY);
+		}
+		g_utilityData.lastFrameTimestamp = timestamp;
 
 		++g_utilityData.fpsCounter;
 
@@ -1192,5 +6892,56 @@ namespace stdgl {
 		return g_utilityData.fps;
 	}
 
+	FrameStats getFrameStats(float hitchMilliseconds) {
+		FrameStats stats = {};
+		unsigned int count = g_utilityData.frameTimeCount;
+		if (count == 0) {
+			return stats;
+		}
+
+		std::vector<float> sorted(g_utilityData.frameTimes, g_utilityData.frameTimes + count);
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for (float frameTime : sorted) {
+			total += frameTime;
+			if (frameTime > hitchMilliseconds) {
+				++stats.hitchCount;
+			}
+		}
+
+		// Nearest rank
+		auto percentile = [&](float p) {
+			size_t rank = (size_t)std::ceil(p * count);
+			return sorted[std::min<size_t>(rank > 0 ? rank - 1 : 0, count - 1)];
+		};
+
+		stats.frameCount = count;
+		stats.min = sorted.front();
+		stats.max = sorted.back();
+		stats.avg = (float)(total / count);
+		stats.p50 = percentile(0.50f);
+		stats.p95 = percentile(0.95f);
+		stats.p99 = percentile(0.99f);
+		return stats;
+	}
+
+	bool exportFrameTimesCSV(const std::string& path) {
+		std::ofstream stream(path, std::ios::trunc);
+		if (!stream) {
+			STDGL_LOG_ERROR_F("Failed to write frame times: {}", path);
+			return false;
+		}
+
+		unsigned int count = g_utilityData.frameTimeCount;
+		unsigned int first = (g_utilityData.frameTimeIndex + STDGL_FRAME_HISTORY - count) % STDGL_FRAME_HISTORY;
+
+		stream << "frame,milliseconds\n";
+		for (unsigned int i = 0; i < count; ++i) {
+			stream << i << ',' << g_utilityData.frameTimes[(first + i) % STDGL_FRAME_HISTORY] << '\n';
+		}
+		return true;
+	}
+
 
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "stdgl_config.h"
+
 #ifndef GLFW_INCLUDE_NONE
 #define GLFW_INCLUDE_NONE
 #endif
@@ -10,11 +12,15 @@
 #include <glm/gtx/quaternion.hpp>
 
 #include <string>
+#include <cstring>
+#include <cstdint>
 #include <vector>
+#include <limits>
 
 #include <optional>
 
 #include <memory>
+#include <atomic>
 
 namespace stdgl {
 	
@@ -26,6 +32,13 @@ namespace stdgl {
 		int x, y;
 	};
 
+	// Generational handle into a resource pool. Unloading changes the generation of the slot,
+	// so copies held elsewhere go stale instead of referring to whatever reuses the slot.
+	struct ResourceHandle {
+		uint32_t index;
+		uint32_t generation; // 0 is never issued, the resource is not managed by a pool
+	};
+
 
 	//---------------------------------------------------------------
 	// [SECTION] Resource utilities
@@ -33,6 +46,10 @@ namespace stdgl {
 
 	std::string loadTextResource(const char* path);
 
+	// Directory for generated caches, STDGL_CACHE_DIRECTORY ("stdgl_cache") by default, empty stores them next to their source
+	void setCacheDirectory(const std::string& directory);
+	const std::string& getCacheDirectory();
+
 
 	//---------------------------------------------------------------
 	// [SECTION] Contexts / forward declarations
@@ -72,6 +89,15 @@ namespace stdgl {
 
 	bool setupInput(GLFWwindow* window, bool installFramebufferCallback = true);
 
+	// Creates a windowless GL 4.6 context and loads GLAD, replaces setupGLFW, the window and setupGLAD.
+	// Requires a stdgl context. Framebuffer 0 is redirected to an offscreen color + depth target of the given size.
+	// Uses EGL (surfaceless Mesa or the default display) with STDGL_HEADLESS_EGL, otherwise a hidden GLFW window.
+	bool setupHeadless(int width, int height);
+	bool isHeadless();
+	// RGBA8 rows of the offscreen target, bottom row first
+	std::vector<unsigned char> readHeadlessFrame();
+	void shutdownHeadless(); // Called by destroyContext
+
 
 	//---------------------------------------------------------------
 	// [SECTION] ImGui
@@ -104,6 +130,10 @@ namespace stdgl {
 		GLenum format;
 		
 		std::string sourcePath;
+		ResourceHandle handle;
+
+		// False while the pixels are still streaming in, draws bind a fallback texture meanwhile
+		bool isReady() const;
 		/*
 		Texture() = default;
 		Texture(GLuint textureID, TextureType type, unsigned int width, unsigned int height,unsigned int channels, GLenum format, const std::string& sourcePath)
@@ -113,14 +143,90 @@ namespace stdgl {
 
 	Texture loadTexture(const std::string& sourcePath, const TextureType& type = TextureType::DIFFUSE);
 
+	// Textures are reference counted, each loadTexture and each mesh using the texture holds a reference.
+	// Unreferenced textures stay cached until the texture budget needs their memory, least recently released first.
+	// The cache is keyed by a hash of the path and by a hash of the file (or embedded) bytes, identical images
+	// under different paths or in different models share one GL texture.
+	void retainTexture(const Texture& texture);
+	void unloadTexture(Texture& texture); // Releases the reference and resets texture
+	bool isTextureLoaded(const Texture& texture); // False once evicted, draws bind a fallback texture instead
+
+	// Estimated VRAM of all cached textures (RGBA8 with mips), STDGL_TEXTURE_BUDGET by default
+	void setTextureBudget(size_t bytes);
+
+	struct TextureCacheStats {
+		size_t residentBytes;
+		size_t budgetBytes;
+		unsigned int residentTextures;
+		unsigned int unreferencedTextures; // Evictable
+		unsigned int evictedTextures; // Since startup
+		unsigned int deduplicatedTextures; // Loads that found the same bytes under another signature
+		size_t bytesSaved; // Estimated VRAM the deduplicated loads did not allocate
+	};
+
+	TextureCacheStats getTextureCacheStats();
+
+	// Upload textures across frames through a pixel buffer ring (default) instead of blocking
+	void setTextureStreaming(bool enabled);
+
 	//---------------------------------------------------------------
 	// [SECTION] Mesh
 	//---------------------------------------------------------------
 
+	// Full precision CPU vertex, encoded into the mesh VertexFormat on upload. Tangents and colors double its size
+	// (and every CPU copy and model cache), they are only stored with STDGL_VERTEX_TANGENT_COLOR set in stdgl_config.h.
 	struct Vertex {
 		glm::vec3 position;
 		glm::vec3 normal;
 		glm::vec2 textureCoordinate;
+	#if STDGL_VERTEX_TANGENT_COLOR
+		glm::vec4 tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f); // w is the bitangent sign
+		glm::vec4 color = glm::vec4(1.0f);
+	#endif
+	};
+	static_assert(sizeof(Vertex) == (STDGL_VERTEX_TANGENT_COLOR ? 64 : 32), "Vertex layout does not match STDGL_VERTEX_TANGENT_COLOR");
+
+	// Per-instance mat4 transform, occupies attributes 3 to 6 (identity for non-instanced draws)
+	constexpr GLuint INSTANCE_TRANSFORM_ATTRIBUTE = 3;
+	constexpr GLuint TANGENT_ATTRIBUTE = 7;
+	constexpr GLuint COLOR_ATTRIBUTE = 8;
+
+	enum class VertexAttributeFormat {
+		NONE, // Attribute is not stored
+		FLOAT,
+		HALF_FLOAT,
+		SNORM16,
+		UNORM16,
+		UNORM8,
+		INT_2_10_10_10 // GL_INT_2_10_10_10_REV, normalized
+	};
+
+	// GPU layout of a mesh's vertex buffer, attributes are interleaved in declaration order.
+	// position: FLOAT or SNORM16, quantized to the mesh bounds (the model bounds for models in shared geometry,
+	//   so multi-draw-indirect keeps one dequantization). Shaders dequantize with
+	//   uniform vec3 positionScale, positionOffset; ... in_position * positionScale + positionOffset
+	// normal, tangent: FLOAT or INT_2_10_10_10 (tangent may be NONE)
+	// textureCoordinate: FLOAT, HALF_FLOAT or UNORM16 (clamped to [0, 1])
+	// color: NONE, FLOAT or UNORM8
+	// With STDGL_VERTEX_TANGENT_COLOR 0 stored tangents and colors hold the Vertex defaults
+	struct VertexFormat {
+		VertexAttributeFormat position;
+		VertexAttributeFormat normal;
+		VertexAttributeFormat textureCoordinate;
+		VertexAttributeFormat tangent;
+		VertexAttributeFormat color;
+
+		GLsizei getStride() const;
+		unsigned int getKey() const; // Unique per layout
+
+		bool operator==(const VertexFormat& other) const { return getKey() == other.getKey(); }
+		bool operator!=(const VertexFormat& other) const { return getKey() != other.getKey(); }
+
+		// 32 bytes, the uncompressed layout
+		VertexFormat() : position(VertexAttributeFormat::FLOAT), normal(VertexAttributeFormat::FLOAT), textureCoordinate(VertexAttributeFormat::FLOAT), tangent(VertexAttributeFormat::NONE), color(VertexAttributeFormat::NONE) {}
+
+		// 16 bytes: SNORM16 positions, INT_2_10_10_10 normals and HALF_FLOAT texture coordinates
+		static VertexFormat compressed();
 	};
 
 	enum class MeshType {
@@ -128,6 +234,22 @@ namespace stdgl {
 		ElementMesh // Indices
 	};
 
+	// What happens to the CPU-side geometry of a Mesh after upload
+	enum class GeometryResidency {
+		KEEP_CPU_COPY, // Mesh::vertices and Mesh::indices hold the geometry
+		GPU_ONLY // Mesh::vertices and Mesh::indices are left empty
+	};
+
+	void setGeometryResidency(GeometryResidency residency);
+	GeometryResidency getGeometryResidency();
+
+	// Simplified index range drawn instead of the full mesh, shares the mesh buffers
+	struct MeshLOD {
+		GLuint firstIndex; // In the index type of the mesh
+		GLsizei indiceCount;
+		float error; // Simplification error in model units
+	};
+
 	struct Mesh {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
@@ -135,25 +257,93 @@ namespace stdgl {
 
 		MeshType type;
 
+		glm::vec3 boundsMin, boundsMax; // Vertex bounds, used for frustum culling
+		glm::vec3 center; // Center of the vertex bounds, used for depth sorting
+		float radius; // Bounding sphere radius around center, used for LOD selection
+
 		GLuint vao; // Loaded vao
 		GLuint vbo; // Loaded vbo
 		GLuint ebo; // Loaded ebo (ElementMesh)
 		GLenum mode; // Loaded mode
 		GLsizei vertexCount; // Loaded vertex count
 		GLsizei indiceCount; // Loaded indice count
+		GLenum indexType; // Loaded index type, the smallest of GL_UNSIGNED_BYTE/SHORT/INT that fits the vertices (ElementMesh)
+
+		bool shared; // Geometry is suballocated from the shared geometry arena (vbo and ebo are 0)
+		GLint baseVertex; // First vertex in the arena
+		GLuint firstIndex; // First indice in the arena
+
+		VertexFormat format; // Loaded vertex layout
+		glm::vec3 positionScale, positionOffset; // Dequantization of SNORM16 positions, identity otherwise
+
+		std::vector<MeshLOD> lods; // Increasingly coarse levels after the full mesh
+		mutable unsigned int lod = 0; // Level drawn last by drawMesh and drawModel, kept for hysteresis
+
+		ResourceHandle handle;
+	};
+
+	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+
+	// Take ownership of the geometry, it is moved into the Mesh when the CPU copy is kept and released otherwise
+	Mesh loadMesh(GLenum mode, std::vector<Vertex>&& vertices, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+	Mesh loadMesh(GLenum mode, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+
+	// Uploads from caller owned memory, it is only copied when the CPU copy is kept
+	Mesh loadMeshFromMemory(GLenum mode, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+
+	// Suballocates the geometry from the shared arena, shared meshes with the same vertex format use the same vao
+	Mesh loadSharedMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+	Mesh loadSharedMesh(GLenum mode, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+	Mesh loadSharedMeshFromMemory(GLenum mode, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, const std::vector<Texture>& textures = {}, const VertexFormat& format = VertexFormat());
+
+	// Meshes are reference counted and hold a reference to each of their textures. Releasing the last reference deletes
+	// the buffers (shared meshes return their arena ranges for reuse) and releases the textures, copies of the Mesh go stale.
+	void retainMesh(const Mesh& mesh);
+	void unloadMesh(Mesh& mesh); // Releases the reference and resets mesh
+	bool isMeshLoaded(const Mesh& mesh); // Stale meshes are skipped by the draw calls
+
+	//// Mesh optimization
+	// Average cache miss ratio (misses per triangle) and average transformed vertex ratio
+	// (misses per vertex, 1.0 is optimal) of a triangle list through a FIFO post-transform cache
+	struct VertexCacheStats {
+		float acmr;
+		float atvr;
 	};
 
-	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<Texture>& textures = {});
-	Mesh loadMesh(GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures = {});
+	struct MeshOptimizationStats {
+		size_t verticesBefore, verticesAfter;
+		VertexCacheStats before, after;
+	};
+
+	VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount);
+
+	// Triangle lists only: welds identical vertices, reorders triangles for the vertex cache and then
+	// for overdraw (outward facing clusters first), finally reorders vertices by first use for fetch locality
+	MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// Quadric error edge collapse of a triangle list down to about targetIndexCount indices. The result
+	// indexes the same vertices. UV seams and open borders are kept in place. error receives the
+	// largest collapse error in model units.
+	std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float* error = nullptr);
 
 
 	//---------------------------------------------------------------
 	// [SECTION] Model (a collection of meshes)
 	//---------------------------------------------------------------
 
+	// Mesh bounds as a structure of arrays (center and half extent), padded to a multiple of 4 for the culling test
+	struct ModelBounds {
+		std::vector<float> centerX, centerY, centerZ;
+		std::vector<float> extentX, extentY, extentZ;
+		size_t count = 0;
+	};
+
 	struct Model {
 		std::vector<Mesh> meshes;
 		std::string sourcePath;
+		ModelBounds bounds; // Built by loadModel, call updateModelBounds after changing meshes
+		ResourceHandle handle; // Issued by loadModel and loadModelAsync
 
 		/*
 		Model() = default;
@@ -163,7 +353,48 @@ namespace stdgl {
 		*/
 	};
 
-	std::optional<Model> loadModel(const std::string& path);
+	struct ModelLoadOptions {
+		bool sharedGeometry; // Load meshes into the shared geometry arena, lets drawModel use multi-draw-indirect
+		bool useCache; // Read/write a binary model cache, skips Assimp when the source is unchanged
+		VertexFormat vertexFormat; // Tangents are generated by the import when the format stores them
+		bool optimizeMeshes; // Run optimizeMesh on every imported mesh, the result is stored in the model cache
+		unsigned int lodLevels; // Simplified levels generated per mesh, each with about half the triangles of the previous
+
+		ModelLoadOptions() : sharedGeometry(true), useCache(true), vertexFormat(), optimizeMeshes(false), lodLevels(0) {}
+	};
+
+	std::optional<Model> loadModel(const std::string& path, const ModelLoadOptions& options = ModelLoadOptions());
+
+	void updateModelBounds(Model& model);
+
+	// Releasing the last reference of a loaded model unloads its meshes, models assembled by hand unload their meshes directly
+	void retainModel(const Model& model);
+	void unloadModel(Model& model); // Releases the reference and resets model
+
+	//// Async loading
+	enum class LoadState {
+		LOADING, // Importing and decoding on a worker thread
+		UPLOADING, // Waiting for GL resources, see processUploads
+		READY,
+		FAILED
+	};
+
+	struct AsyncModel {
+		std::atomic<LoadState> state;
+		Model model; // Valid once state is READY
+
+		bool isReady() const { return state == LoadState::READY; }
+
+		AsyncModel() : state(LoadState::LOADING), model() {}
+	};
+
+	// Import, vertex conversion and image decode run on a worker pool,
+	// GL resources are created by processUploads on the GL thread
+	std::shared_ptr<AsyncModel> loadModelAsync(const std::string& path, const ModelLoadOptions& options = ModelLoadOptions());
+
+	// Creates GL resources for imported models until the budget is spent, called by newFrame
+	void processUploads(float budgetMilliseconds);
+	void setUploadBudget(float milliseconds);
 
 
 	//---------------------------------------------------------------
@@ -200,6 +431,12 @@ namespace stdgl {
 
 	void shaderBindAttribute(unsigned int index, const std::string& name);
 
+	// Queue compiles in endShader and finish them without blocking from newFrame (pollShaderCompiles),
+	// useShader returns false until the program is linked. Uses GL_KHR_parallel_shader_compile when available.
+	void setParallelShaderCompile(bool enabled);
+	void pollShaderCompiles();
+	bool isShaderReady(const char* name);
+
 	//// Use functions
 	bool useShader(const char* name);
 	void stopShader();
@@ -211,8 +448,37 @@ namespace stdgl {
 	void shaderLoadVec4(const char* name, glm::vec4 value);
 	void shaderLoadMat4(const char* name, glm::mat4 value);
 
+	// Shaders using the CameraData block get the block rebound to camera (for every shader until the frame camera is loaded again)
 	void shaderLoadCamera(const Camera& camera);
 
+	//// Uniform handles
+	// Resolved once against the active shader, uploads without any name lookup.
+	// A handle is only valid for the program it was resolved with.
+	template<typename T>
+	struct UniformHandle {
+		GLint location;
+
+		bool isValid() const { return location >= 0; }
+		void load(const T& value) const;
+
+		UniformHandle() : location(-1) {}
+		explicit UniformHandle(GLint location) : location(location) {}
+	};
+
+	template<> void UniformHandle<int>::load(const int& value) const;
+	template<> void UniformHandle<float>::load(const float& value) const;
+	template<> void UniformHandle<glm::vec2>::load(const glm::vec2& value) const;
+	template<> void UniformHandle<glm::vec3>::load(const glm::vec3& value) const;
+	template<> void UniformHandle<glm::vec4>::load(const glm::vec4& value) const;
+	template<> void UniformHandle<glm::mat4>::load(const glm::mat4& value) const;
+
+	GLint getUniformLocation(const char* name);
+
+	template<typename T>
+	UniformHandle<T> getUniform(const char* name) {
+		return UniformHandle<T>(getUniformLocation(name));
+	}
+
 
 	//---------------------------------------------------------------
 	// [SECTION] Framebuffer
@@ -240,15 +506,40 @@ namespace stdgl {
 	// [SECTION] Renderer
 	//---------------------------------------------------------------
 
+	enum class RenderMode {
+		IMMEDIATE, // Draw calls execute when submitted
+		QUEUED // Draw calls are sorted by state and depth, then executed in endRender
+	};
+
+	// A mesh LOD is drawn while its error projects to at most pixelError pixels on screen. Switching
+	// to a coarser level also needs the error below pixelError * (1 - hysteresis), which avoids popping
+	// back and forth at the threshold. A pixelError of 0 always draws the full mesh.
+	struct LODSettings {
+		float pixelError;
+		float hysteresis;
+
+		LODSettings() : pixelError(1.0f), hysteresis(0.25f) {}
+	};
+
 	struct RenderContext {
 		std::shared_ptr<Camera> camera;
+		RenderMode renderMode;
+		LODSettings lodSettings;
+		bool frustumCulling; // drawModel(model, transform) skips meshes outside the camera frustum
+		bool occlusionCulling; // and meshes hidden behind the depth pyramid, see buildDepthPyramid
+
+		// Camera matrices, computed once per beginRender
+		glm::mat4 view;
+		glm::mat4 viewProjection;
 
 		int width, height;
 
-		RenderContext() : camera(), width(0), height(0) {}
+		RenderContext() : camera(), renderMode(RenderMode::IMMEDIATE), lodSettings(), frustumCulling(true), occlusionCulling(true), view(1.0f), viewProjection(1.0f), width(0), height(0) {}
 	};
 
-	void beginRender(std::shared_ptr<Camera> camera);
+	// In queued mode a draw records the shader, textures, mesh and the uniforms loaded through stdgl until then,
+	// which are replayed before it executes. Queued meshes must stay alive until endRender. Instanced draws always execute immediately.
+	void beginRender(std::shared_ptr<Camera> camera, RenderMode renderMode = RenderMode::IMMEDIATE);
 	void endRender();
 
 	void clearFramebuffer();
@@ -258,22 +549,261 @@ namespace stdgl {
 
 	void setRendererSize(int width, int height);
 
+	void setLODSettings(const LODSettings& settings);
+
+	// drawModel tests the mesh bounds against the camera frustum when given the model transform
+	void setFrustumCulling(bool enabled);
+
+	// Hierarchical-Z occlusion culling, runs after the frustum test. buildDepthPyramid reduces the depth attachment of a
+	// framebuffer to a max-depth pyramid with a compute shader (OpenGL 4.3) and reads a small level back without stalling.
+	// Bounds are tested against that copy with the camera it was rendered with, so results lag a frame or two and occluders
+	// that move can briefly hide what is behind them. Culling stops when buildDepthPyramid is not called for a frame.
+	void setOcclusionCulling(bool enabled);
+	// Call once per frame after the occluders are drawn, framebufferName as given to beginFramebuffer
+	void buildDepthPyramid(const char* framebufferName);
+
+	struct CullingStats {
+		unsigned int testedMeshes;
+		unsigned int culledMeshes; // Outside the frustum
+		unsigned int occludedMeshes; // Inside the frustum, behind the depth pyramid
+		unsigned int visibleMeshes;
+	};
+
+	// Counts of the previous frame
+	CullingStats getCullingStats();
+	// Picks the level drawMesh and drawModel use from the projected size of the mesh bounds under transform, instanced draws use the full mesh.
+	// Levels coarser than previousLevel need the error clearly below LODSettings::pixelError. drawScene passes each object's last level,
+	// the other draws the mesh's last level (Mesh::lod), so a mesh drawn at several transforms should go through the scene.
+	unsigned int selectMeshLOD(const Mesh& mesh, const glm::mat4& transform = glm::mat4(1.0f), unsigned int previousLevel = 0);
+
 	void drawMesh(const Mesh& mesh, bool skipTextures = false);
+	// Draws every mesh, the bounds are only culled by the transform overload
 	void drawModel(const Model& model, bool skipTextures = false);
+	// transform is the model matrix the shader applies, frustum culling tests the bounds with it
+	void drawModel(const Model& model, const glm::mat4& transform, bool skipTextures = false);
+
+	void drawMeshInstanced(const Mesh& mesh, const glm::mat4* transforms, size_t count, bool skipTextures = false);
+	void drawMeshInstanced(const Mesh& mesh, const std::vector<glm::mat4>& transforms, bool skipTextures = false);
+	void drawModelInstanced(const Model& model, const glm::mat4* transforms, size_t count, bool skipTextures = false);
+	void drawModelInstanced(const Model& model, const std::vector<glm::mat4>& transforms, bool skipTextures = false);
 
 	void bindTexture(const Texture& texture, int unit = 0, std::string name = "texture_diffuse");
+
+	//// State
+	// State changes go through a cache and are skipped when redundant, the last used
+	// program, vao and textures stay bound. Invalidate after changing GL state outside of stdgl.
+	void setBlending(bool enabled);
+	void setDepthTest(bool enabled);
+	void setFaceCulling(bool enabled);
+	void invalidateStateCache();
+
+	struct StateCacheStats {
+		unsigned int issuedCalls;
+		unsigned int elidedCalls;
+	};
+
+	// Counts of the previous frame
+	StateCacheStats getStateCacheStats();
 	
+	//---------------------------------------------------------------
+	// [SECTION] Scene
+	//---------------------------------------------------------------
+
+	typedef int SceneObjectID;
+	constexpr SceneObjectID INVALID_SCENE_OBJECT = -1;
+
+	struct SceneObject {
+		const Mesh* mesh; // Not owned, must outlive the object
+		glm::mat4 transform;
+		glm::mat4 inverseTransform; // Moves rays into mesh space
+		int node; // Leaf in Scene::nodes, next free slot when mesh is null
+		mutable unsigned int lod; // Level drawn last by drawScene, kept per object for hysteresis
+	};
+
+	struct SceneNode {
+		glm::vec3 boundsMin, boundsMax; // World bounds, leaves are enlarged by STDGL_SCENE_MARGIN so small moves need no update
+		int parent; // Next free node for free nodes
+		int children[2]; // -1 for leaves
+		SceneObjectID object; // Leaves only
+		int height; // Leaves are 0, -1 for free nodes
+	};
+
+	// Dynamic AABB tree over placed meshes. Inserts pick the sibling by surface area and rotate to stay balanced,
+	// moves only update the tree once an object leaves its enlarged bounds. Queries visit O(log n) nodes for small results.
+	struct Scene {
+		std::vector<SceneNode> nodes;
+		std::vector<SceneObject> objects;
+		int root;
+		int freeNode;
+		SceneObjectID freeObject; // Free object slots are chained through SceneObject::node
+
+		Scene() : nodes(), objects(), root(-1), freeNode(-1), freeObject(INVALID_SCENE_OBJECT) {}
+	};
+
+	SceneObjectID addSceneObject(Scene& scene, const Mesh& mesh, const glm::mat4& transform);
+	std::vector<SceneObjectID> addSceneModel(Scene& scene, const Model& model, const glm::mat4& transform);
+	void removeSceneObject(Scene& scene, SceneObjectID object);
+	void moveSceneObject(Scene& scene, SceneObjectID object, const glm::mat4& transform);
+
+	// Objects whose bounds intersect the frustum of viewProjection
+	void querySceneFrustum(const Scene& scene, const glm::mat4& viewProjection, std::vector<SceneObjectID>& results);
+
+	struct SceneRayHit {
+		SceneObjectID object;
+		float distance; // Along direction, in units of its length
+		glm::vec3 position;
+	};
+
+	// Nearest hit, against the triangles of meshes that keep their CPU geometry and against the bounds otherwise
+	bool raycastScene(const Scene& scene, const glm::vec3& origin, const glm::vec3& direction, SceneRayHit& hit, float maxDistance = std::numeric_limits<float>::max());
+
+	// Draws the objects in the camera frustum like drawMesh (queued and sorted in RenderMode::QUEUED),
+	// loading each transform into the mat4 uniform STDGL_SCENE_MODEL_UNIFORM ("model") of the active shader
+	void drawScene(const Scene& scene, bool skipTextures = false);
+
+	//---------------------------------------------------------------
+	// [SECTION] Uniform buffer
+	//---------------------------------------------------------------
+
+	// Per-frame camera block, written once in beginRender. Shaders opt in with:
+	// layout(std140, binding = 0) uniform CameraData { mat4 projection; mat4 view; mat4 viewProjection; vec4 cameraPosition; };
+	constexpr GLuint CAMERA_UNIFORM_BINDING = 0;
+
+	// Per-draw block for multi-draw-indirect model draws, x holds the mesh index within the model:
+	// layout(std140, binding = 1) uniform DrawData { uvec4 drawData[1024]; }; ... drawData[gl_DrawID].x
+	constexpr GLuint DRAW_UNIFORM_BINDING = 1;
+	constexpr unsigned int MAX_DRAWS_PER_BATCH = 1024;
+
+	struct CameraUniforms {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 viewProjection;
+		glm::vec4 position;
+	};
+
+	struct UniformAllocation {
+		GLuint bufferID;
+		GLintptr offset;
+		GLsizeiptr size;
+		void* data; // Mapped write pointer, nullptr if the allocation failed
+	};
+
+	// Linear allocation from the current frame region, valid until endRender
+	UniformAllocation allocateUniforms(GLsizeiptr size);
+	void bindUniforms(const UniformAllocation& allocation, GLuint binding);
+
+	template<typename T>
+	UniformAllocation loadUniformBlock(GLuint binding, const T& value) {
+		UniformAllocation allocation = allocateUniforms(sizeof(T));
+		if (allocation.data != nullptr) {
+			std::memcpy(allocation.data, &value, sizeof(T));
+			bindUniforms(allocation, binding);
+		}
+		return allocation;
+	}
+
+	//---------------------------------------------------------------
+	// [SECTION] Profiler
+	//---------------------------------------------------------------
+
+	#define STDGL_CONCAT_IMPL(a, b) a##b
+	#define STDGL_CONCAT(a, b) STDGL_CONCAT_IMPL(a, b)
+
+	// GPU zones are timestamp queries read back STDGL_GPU_PROFILER_FRAMES late, so they never stall.
+	// Zone ids hash the name with the parent zone id as seed, the ID stack is left untouched.
+	#define STDGL_GPU_ZONE(name) ::stdgl::GPUZoneScope STDGL_CONCAT(stdglGpuZone, __LINE__)(name)
+
+	struct GPUZoneResult {
+		StdGLID id;
+		StdGLID parent; // 0 for top level zones
+		const char* name; // Valid until the profiler is destroyed
+		int depth;
+		float startMilliseconds; // Relative to the start of the frame
+		float milliseconds;
+	};
+
+	// Disabled by default, toggling takes effect on the next newFrame
+	void setGPUProfiling(bool enabled);
+	bool isGPUProfiling();
+
+	void beginGPUZone(const char* name);
+	void endGPUZone();
+
+	struct GPUZoneScope {
+		GPUZoneScope(const char* name) { beginGPUZone(name); }
+		~GPUZoneScope() { endGPUZone(); }
+
+		GPUZoneScope(const GPUZoneScope&) = delete;
+		GPUZoneScope& operator=(const GPUZoneScope&) = delete;
+	};
+
+	// Latest resolved frame, zones in begin order (depth first)
+	const std::vector<GPUZoneResult>& getGPUZones();
+	float getGPUFrameTime();
+
+	// ImGui window with the zone tree, requires setupImGui
+	void showGPUProfiler(bool* open = nullptr);
+
+	// CPU zones are only compiled in with STDGL_PROFILE defined, names must be string literals.
+	// Zones are only kept while a capture runs, each thread records into its own ring of STDGL_CPU_PROFILER_EVENTS zones.
+	#ifdef STDGL_PROFILE
+		#define STDGL_CPU_ZONE(name) ::stdgl::CPUZoneScope STDGL_CONCAT(stdglCpuZone, __LINE__)(name)
+	#else
+		#define STDGL_CPU_ZONE(name)
+	#endif
+
+	uint64_t getProfilerTimestamp(); // Nanoseconds, monotonic
+	void recordCPUZone(const char* name, uint64_t start, uint64_t end);
+
+	struct CPUZoneScope {
+		const char* name;
+		uint64_t start;
+
+		CPUZoneScope(const char* name) : name(name), start(getProfilerTimestamp()) {}
+		~CPUZoneScope() { recordCPUZone(name, start, getProfilerTimestamp()); }
+
+		CPUZoneScope(const CPUZoneScope&) = delete;
+		CPUZoneScope& operator=(const CPUZoneScope&) = delete;
+	};
+
+	// Records the next frames zones and writes them as Chrome trace event JSON (Perfetto, chrome://tracing)
+	// Returns false without STDGL_PROFILE or while a capture is running
+	bool captureCPUTrace(const std::string& path, int frames = 1);
+	bool isCapturingCPUTrace();
+
+
 	//---------------------------------------------------------------
 	// [SECTION] Context definition
 	//---------------------------------------------------------------
 
+	// Shadow copy of the GL state bound through stdgl, used to skip redundant calls
+	struct StateCache {
+		static constexpr GLuint UNKNOWN = 0xFFFFFFFF;
+		static constexpr unsigned int TEXTURE_UNITS = 32;
+
+		GLuint program;
+		GLuint vertexArray;
+		GLuint framebuffer;
+		GLuint activeTextureUnit;
+		GLuint textures[TEXTURE_UNITS]; // GL_TEXTURE_2D binding per unit
+		int blend, depthTest, cullFace; // -1 when unknown
+
+		unsigned int issuedCalls, elidedCalls; // Current frame
+		unsigned int lastIssuedCalls, lastElidedCalls; // Previous frame
+
+		void invalidate();
+
+		StateCache() : issuedCalls(0), elidedCalls(0), lastIssuedCalls(0), lastElidedCalls(0) { invalidate(); }
+	};
+
 	struct Context {
 		RenderContext renderContext;
+		StateCache stateCache;
 		std::vector<StdGLID> idStack;
 
 		StdGLID getID(const char* str, const char* str_end = nullptr);
 
-		Context() : renderContext(), idStack({0}) {}
+		Context() : renderContext(), stateCache(), idStack({0}) {}
 	};
 
 
@@ -281,10 +811,25 @@ namespace stdgl {
 	// [SECTION] Utilities
 	//---------------------------------------------------------------
 
+	// Frame times in milliseconds over the recorded history
+	struct FrameStats {
+		unsigned int frameCount;
+		float min, avg, max;
+		float p50, p95, p99;
+		unsigned int hitchCount; // Frames above the hitch threshold
+	};
+
+	// Over the last STDGL_FRAME_HISTORY frames
+	FrameStats getFrameStats(float hitchMilliseconds = 1000.0f / 30.0f);
+	// One "frame,milliseconds" row per recorded frame, oldest first
+	bool exportFrameTimesCSV(const std::string& path);
+
 	struct Timestep {
 		const float deltaTime;
-		const float timeSinceStart;
+		const float timeSinceStart; // Seconds since the first newFrame
 		const float fps;
+
+		FrameStats getStats(float hitchMilliseconds = 1000.0f / 30.0f) const { return getFrameStats(hitchMilliseconds); }
 	};
 
 	// Marks a new frame
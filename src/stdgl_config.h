@@ -0,0 +1,12 @@
+#pragma once
+
+// Build-wide configuration, included by stdgl.h before anything else.
+// Options here change the layout of public types, so every translation unit of a build must see the same
+// values: edit them in this file (or define them for the whole project), never per file, or the one
+// definition rule is broken. stdgl.h checks the resulting layouts with static_assert.
+
+// 1 stores tangents and colors in Vertex, doubling it from 32 to 64 bytes (and every CPU copy and model cache).
+// With 0, vertex formats that store tangents or colors encode the Vertex defaults.
+#ifndef STDGL_VERTEX_TANGENT_COLOR
+#define STDGL_VERTEX_TANGENT_COLOR 0
+#endif
@@ -0,0 +1,12 @@
+#version 460
+
+out vec4 fragColor;
+
+in vec2 textureCoord;
+
+uniform vec4 color;
+uniform int mode;
+
+void main() {
+	fragColor = color * vec4(textureCoord, float(mode), 1.0f);
+}
@@ -0,0 +1,24 @@
+#version 460
+
+in vec3 in_position;
+in vec3 in_normal;
+in vec2 in_textureCoord;
+
+out vec2 textureCoord;
+
+layout(std140, binding = 0) uniform CameraData {
+	mat4 projection;
+	mat4 view;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+};
+
+uniform mat4 model;
+uniform float time;
+
+void main() {
+	textureCoord = in_textureCoord;
+
+	// A small wobble, time must reach the output or the uniform is optimized out
+	gl_Position = viewProjection * model * vec4(in_position + in_normal * sin(time) * 0.01f, 1.0f);
+}
@@ -0,0 +1,489 @@
+#include <stdgl.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Usage: stdgl_bench [--out results.json] [--filter substring] [--samples n]
+// Every benchmark runs one warmup sample, then `samples` timed samples of a fixed iteration count.
+// Inputs are generated deterministically into the temp directory, so runs are comparable across machines.
+
+const int WIDTH = 1280;
+const int HEIGHT = 720;
+
+struct BenchResult {
+	std::string name;
+	uint64_t iterations; // Per sample
+	double minNanoseconds; // Per iteration
+	double medianNanoseconds;
+	double p95Nanoseconds;
+	double opsPerSecond; // From the median
+};
+
+struct BenchData {
+	std::vector<BenchResult> results;
+
+	std::string outputPath;
+	std::string filter;
+	int samples = 10;
+
+	std::filesystem::path dataDirectory;
+	std::shared_ptr<stdgl::Camera> camera;
+
+	volatile uint64_t sink = 0; // Keeps benchmarked results alive
+};
+
+static BenchData g_benchData;
+
+using Clock = std::chrono::steady_clock;
+
+// gpu: waits for the GPU after every sample, so queued GL work is part of the measurement
+void runBenchmark(const std::string& name, uint64_t iterations, const std::function<void(uint64_t)>& body, bool gpu = false) {
+	if (!g_benchData.filter.empty() && name.find(g_benchData.filter) == std::string::npos) {
+		return;
+	}
+
+	auto sample = [&]() {
+		Clock::time_point start = Clock::now();
+		body(iterations);
+		if (gpu) {
+			glFinish();
+		}
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() / (double)iterations;
+	};
+
+	sample(); // Warmup
+
+	std::vector<double> times;
+	for (int i = 0; i < g_benchData.samples; ++i) {
+		times.push_back(sample());
+	}
+	std::sort(times.begin(), times.end());
+
+	BenchResult result;
+	result.name = name;
+	result.iterations = iterations;
+	result.minNanoseconds = times.front();
+	result.medianNanoseconds = times[times.size() / 2];
+	result.p95Nanoseconds = times[std::min(times.size() - 1, (size_t)(times.size() * 0.95))];
+	result.opsPerSecond = result.medianNanoseconds > 0.0 ? 1.0e9 / result.medianNanoseconds : 0.0;
+	g_benchData.results.push_back(result);
+
+	std::printf("%-48s %14.1f ns/op %14.1f ops/s\n", name.c_str(), result.medianNanoseconds, result.opsPerSecond);
+}
+
+std::string escapeJSON(const std::string& text) {
+	std::string escaped;
+	escaped.reserve(text.size());
+	for (char c : text) {
+		switch (c) {
+		case '"': escaped += "\\\""; break;
+		case '\\': escaped += "\\\\"; break;
+		case '\n': escaped += "\\n"; break;
+		case '\r': escaped += "\\r"; break;
+		case '\t': escaped += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20) {
+				char code[7];
+				std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+				escaped += code;
+			}
+			else {
+				escaped += c;
+			}
+		}
+	}
+	return escaped;
+}
+
+void writeResults() {
+	if (g_benchData.outputPath.empty()) {
+		return;
+	}
+
+	std::ofstream stream(g_benchData.outputPath, std::ios::trunc);
+	stream << "{\n";
+	stream << "\t\"renderer\": \"" << escapeJSON((const char*)glGetString(GL_RENDERER)) << "\",\n";
+	stream << "\t\"version\": \"" << escapeJSON((const char*)glGetString(GL_VERSION)) << "\",\n";
+	stream << "\t\"samples\": " << g_benchData.samples << ",\n";
+	stream << "\t\"benchmarks\": [\n";
+	for (size_t i = 0; i < g_benchData.results.size(); ++i) {
+		const BenchResult& result = g_benchData.results[i];
+		stream << "\t\t{ \"name\": \"" << escapeJSON(result.name) << "\""
+			<< ", \"iterations\": " << result.iterations
+			<< ", \"min_ns\": " << result.minNanoseconds
+			<< ", \"median_ns\": " << result.medianNanoseconds
+			<< ", \"p95_ns\": " << result.p95Nanoseconds
+			<< ", \"ops_per_second\": " << result.opsPerSecond
+			<< " }" << (i + 1 < g_benchData.results.size() ? "," : "") << "\n";
+	}
+	stream << "\t]\n}\n";
+}
+
+
+//---------------------------------------------------------------
+// Generated inputs
+//---------------------------------------------------------------
+
+std::string writeTextFile(const std::string& name, size_t size) {
+	std::filesystem::path path = g_benchData.dataDirectory / name;
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+
+	std::string line = "// The quick brown fox jumps over the lazy dog 0123456789\n";
+	for (size_t written = 0; written < size; written += line.size()) {
+		stream << line;
+	}
+	return path.string();
+}
+
+// Uncompressed 32 bit TGA, decoded by stb_image without any inflate cost
+std::string writeTGAFile(const std::string& name, int width, int height, unsigned int seed) {
+	std::filesystem::path path = g_benchData.dataDirectory / name;
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+
+	unsigned char header[18] = {};
+	header[2] = 2; // Uncompressed true color
+	header[12] = (unsigned char)(width & 0xFF);
+	header[13] = (unsigned char)(width >> 8);
+	header[14] = (unsigned char)(height & 0xFF);
+	header[15] = (unsigned char)(height >> 8);
+	header[16] = 32;
+	header[17] = 8; // Alpha bits
+	stream.write((const char*)header, sizeof(header));
+
+	std::vector<unsigned char> pixels((size_t)width * height * 4);
+	for (size_t i = 0; i < pixels.size(); ++i) {
+		pixels[i] = (unsigned char)((i * 31 + seed * 17) & 0xFF);
+	}
+	// The pattern repeats every 256 seeds, the seed itself in the first pixel keeps every file unique for the content dedupe
+	for (size_t i = 0; i < 4 && i < pixels.size(); ++i) {
+		pixels[i] = (unsigned char)(seed >> (i * 8));
+	}
+	stream.write((const char*)pixels.data(), pixels.size());
+	return path.string();
+}
+
+// Grid of (resolution + 1)^2 vertices and 2 * resolution^2 triangles
+std::string writeGridOBJ(const std::string& name, int resolution) {
+	std::filesystem::path path = g_benchData.dataDirectory / name;
+	std::ofstream stream(path, std::ios::trunc);
+
+	for (int y = 0; y <= resolution; ++y) {
+		for (int x = 0; x <= resolution; ++x) {
+			float u = (float)x / resolution;
+			float v = (float)y / resolution;
+			stream << "v " << u * 2.0f - 1.0f << " " << v * 2.0f - 1.0f << " 0\n";
+			stream << "vt " << u << " " << v << "\n";
+		}
+	}
+	stream << "vn 0 0 1\n";
+
+	for (int y = 0; y < resolution; ++y) {
+		for (int x = 0; x < resolution; ++x) {
+			int a = y * (resolution + 1) + x + 1;
+			int b = a + 1;
+			int c = a + resolution + 1;
+			int d = c + 1;
+			stream << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << d << "/" << d << "/1\n";
+			stream << "f " << a << "/" << a << "/1 " << d << "/" << d << "/1 " << c << "/" << c << "/1\n";
+		}
+	}
+	return path.string();
+}
+
+// One small quad per mesh, spread over a square
+stdgl::Model createQuadModel(size_t meshCount) {
+	stdgl::Model model;
+	model.meshes.reserve(meshCount);
+
+	size_t side = (size_t)std::ceil(std::sqrt((double)meshCount));
+	std::vector<unsigned int> indices = { 0, 1, 2, 0, 2, 3 };
+
+	for (size_t i = 0; i < meshCount; ++i) {
+		glm::vec3 offset((float)(i % side) / side * 2.0f - 1.0f, (float)(i / side) / side * 2.0f - 1.0f, 0.0f);
+		float size = 1.0f / side;
+
+		std::vector<stdgl::Vertex> vertices = {
+			stdgl::Vertex{ offset + glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 0.0f) },
+			stdgl::Vertex{ offset + glm::vec3(size, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(1.0f, 0.0f) },
+			stdgl::Vertex{ offset + glm::vec3(size, size, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(1.0f, 1.0f) },
+			stdgl::Vertex{ offset + glm::vec3(0.0f, size, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 1.0f) },
+		};
+		model.meshes.push_back(stdgl::loadSharedMesh(GL_TRIANGLES, vertices, indices));
+	}
+	stdgl::updateModelBounds(model);
+	return model;
+}
+
+
+//---------------------------------------------------------------
+// Micro benchmarks
+//---------------------------------------------------------------
+
+void benchHashing() {
+	for (size_t length : { 8, 64, 1024 }) {
+		std::string str(length, 'a');
+		for (size_t i = 0; i < length; ++i) {
+			str[i] = (char)('a' + i % 26);
+		}
+
+		runBenchmark("micro/getID/" + std::to_string(length) + "B", 1000000 / (length / 8), [&](uint64_t iterations) {
+			uint64_t hash = 0;
+			for (uint64_t i = 0; i < iterations; ++i) {
+				str[0] = (char)('a' + i % 26);
+				hash += stdgl::getID(str.c_str());
+			}
+			g_benchData.sink += hash;
+		});
+	}
+}
+
+void benchTextResource() {
+	for (size_t megabytes : { 1, 16 }) {
+		std::string path = writeTextFile("text_" + std::to_string(megabytes) + ".txt", megabytes * 1024 * 1024);
+
+		runBenchmark("micro/loadTextResource/" + std::to_string(megabytes) + "MiB", 4, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				g_benchData.sink += stdgl::loadTextResource(path.c_str()).size();
+			}
+		});
+	}
+}
+
+void benchUniforms() {
+	if (stdgl::beginShader("benchShader")) {
+		stdgl::shaderUseVertexFile("res/bench_v.glsl");
+		stdgl::shaderUseFragmentFile("res/bench_f.glsl");
+
+		stdgl::shaderBindAttribute(0, "in_position");
+		stdgl::shaderBindAttribute(1, "in_normal");
+		stdgl::shaderBindAttribute(2, "in_textureCoord");
+
+		stdgl::endShader();
+	}
+
+	if (!stdgl::useShader("benchShader")) {
+		std::printf("Skipping uniform benchmarks, benchShader failed to build\n");
+		return;
+	}
+
+	glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+
+	runBenchmark("micro/shaderLoadMat4", 100000, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			stdgl::shaderLoadMat4("model", model);
+		}
+	}, true);
+
+	runBenchmark("micro/shaderLoadVec4", 100000, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			stdgl::shaderLoadVec4("color", glm::vec4((float)i));
+		}
+	}, true);
+
+	runBenchmark("micro/shaderLoadFloat", 100000, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			stdgl::shaderLoadFloat("time", (float)i);
+		}
+	}, true);
+
+	runBenchmark("micro/shaderLoadInt", 100000, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			stdgl::shaderLoadInt("mode", (int)(i & 1));
+		}
+	}, true);
+
+	stdgl::UniformHandle<glm::mat4> modelHandle = stdgl::getUniform<glm::mat4>("model");
+	runBenchmark("micro/UniformHandle<mat4>::load", 100000, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			modelHandle.load(model);
+		}
+	}, true);
+
+	stdgl::stopShader();
+}
+
+
+//---------------------------------------------------------------
+// Macro benchmarks
+//---------------------------------------------------------------
+
+void benchModelImport() {
+	for (int resolution : { 64, 256 }) {
+		std::string path = writeGridOBJ("grid_" + std::to_string(resolution) + ".obj", resolution);
+		std::string suffix = std::to_string((resolution + 1) * (resolution + 1)) + "v";
+
+		// Assimp import and processMesh vertex conversion on every iteration
+		stdgl::ModelLoadOptions uncached;
+		uncached.useCache = false;
+		runBenchmark("macro/loadModel/uncached/" + suffix, 3, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				std::optional<stdgl::Model> model = stdgl::loadModel(path, uncached);
+				g_benchData.sink += model ? model->meshes.size() : 0;
+				if (model) {
+					stdgl::unloadModel(*model);
+				}
+			}
+		}, true);
+
+		// Memory mapped binary cache written by the warmup
+		runBenchmark("macro/loadModel/cached/" + suffix, 3, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				std::optional<stdgl::Model> model = stdgl::loadModel(path);
+				g_benchData.sink += model ? model->meshes.size() : 0;
+				if (model) {
+					stdgl::unloadModel(*model);
+				}
+			}
+		}, true);
+	}
+}
+
+void benchTextures() {
+	stdgl::setTextureStreaming(false);
+
+	// Distinct paths per iteration, every load decodes and uploads
+	const uint64_t coldIterations = 8;
+	std::vector<std::string> paths;
+	for (int i = 0; i < (g_benchData.samples + 1) * (int)coldIterations; ++i) {
+		paths.push_back(writeTGAFile("texture_" + std::to_string(i) + ".tga", 512, 512, i));
+	}
+
+	size_t next = 0;
+	runBenchmark("macro/loadTexture/cold/512x512", coldIterations, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			g_benchData.sink += stdgl::loadTexture(paths[next++ % paths.size()]).textureID;
+		}
+	}, true);
+
+	runBenchmark("macro/loadTexture/cached/512x512", 100000, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			g_benchData.sink += stdgl::loadTexture(paths[0]).textureID;
+		}
+	});
+
+	stdgl::setTextureStreaming(true);
+}
+
+void benchDrawModel() {
+	if (!stdgl::isShaderReady("benchShader")) {
+		std::printf("Skipping draw benchmarks, benchShader failed to build\n");
+		return;
+	}
+
+	for (size_t meshCount : { 1, 100, 1000, 10000, 100000 }) {
+		stdgl::Model model = createQuadModel(meshCount);
+		std::string suffix = std::to_string(meshCount);
+		uint64_t frames = meshCount >= 10000 ? 4 : 32;
+
+		auto drawFrame = [&](const std::function<void()>& draw) {
+			stdgl::newFrame();
+			stdgl::beginRender(g_benchData.camera);
+			stdgl::clearFramebuffer();
+			stdgl::useShader("benchShader");
+			stdgl::shaderLoadMat4("model", glm::mat4(1.0f));
+			stdgl::shaderLoadVec4("color", glm::vec4(1.0f));
+			draw();
+			stdgl::stopShader();
+			stdgl::endRender();
+		};
+
+		// All meshes are in the shared arena, drawModel uses multi-draw-indirect
+		runBenchmark("macro/drawModel/indirect/" + suffix, frames, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				drawFrame([&]() { stdgl::drawModel(model, true); });
+			}
+		}, true);
+
+		// One draw call per mesh
+		runBenchmark("macro/drawModel/per-mesh/" + suffix, frames, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i) {
+				drawFrame([&]() {
+					for (const stdgl::Mesh& mesh : model.meshes) {
+						stdgl::drawMesh(mesh, true);
+					}
+				});
+			}
+		}, true);
+
+		stdgl::unloadModel(model);
+	}
+}
+
+void benchFramebufferResize() {
+	runBenchmark("macro/framebufferResize", 64, [&](uint64_t iterations) {
+		for (uint64_t i = 0; i < iterations; ++i) {
+			int width = (i & 1) ? 1280 : 1920;
+			int height = (i & 1) ? 720 : 1080;
+			if (stdgl::beginFramebuffer("benchFramebuffer", width, height)) {
+				stdgl::addAttachment(stdgl::FramebufferAttachmentType::COLOR);
+				stdgl::addAttachment(stdgl::FramebufferAttachmentType::DEPTH);
+				stdgl::buildFramebuffer();
+				stdgl::endFramebuffer();
+			}
+		}
+	}, true);
+}
+
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--out" && i + 1 < argc) {
+			g_benchData.outputPath = argv[++i];
+		}
+		else if (arg == "--filter" && i + 1 < argc) {
+			g_benchData.filter = argv[++i];
+		}
+		else if (arg == "--samples" && i + 1 < argc) {
+			g_benchData.samples = std::max(1, std::atoi(argv[++i]));
+		}
+	}
+
+	g_benchData.dataDirectory = std::filesystem::temp_directory_path() / "stdgl_bench";
+	std::filesystem::remove_all(g_benchData.dataDirectory);
+	std::filesystem::create_directories(g_benchData.dataDirectory);
+
+	stdgl::Context* context = stdgl::createContext();
+	stdgl::setCacheDirectory(g_benchData.dataDirectory.string());
+
+	if (!stdgl::setupHeadless(WIDTH, HEIGHT)) {
+		std::printf("Failed to create headless context\n");
+		return -1;
+	}
+	stdgl::setupOpenGL();
+	stdgl::setupSTB();
+
+	g_benchData.camera = std::make_shared<stdgl::Camera>(glm::vec3(0.0f, 0.0f, 2.0f));
+	stdgl::useCamera(g_benchData.camera);
+	stdgl::setRendererSize(WIDTH, HEIGHT);
+
+	std::printf("Renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+	benchHashing();
+	benchTextResource();
+	benchUniforms();
+
+	benchModelImport();
+	benchTextures();
+	benchDrawModel();
+	benchFramebufferResize();
+
+	writeResults();
+
+	stdgl::destroyContext(context);
+	std::filesystem::remove_all(g_benchData.dataDirectory);
+	return 0;
+}
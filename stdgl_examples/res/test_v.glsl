@@ -8,8 +8,12 @@ out vec3 position;
 out vec3 normal;
 out vec2 textureCoord;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout(std140, binding = 0) uniform CameraData {
+	mat4 projection;
+	mat4 view;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+};
 
 
 void main() {
@@ -25,7 +25,7 @@ static std::vector<stdgl::Vertex> g_triangleData = {
 struct ExampleData {
 
 	std::unique_ptr<stdgl::Mesh> triangleMesh;
-	std::unique_ptr<stdgl::Model> testModel;
+	std::shared_ptr<stdgl::AsyncModel> testModel;
 
 	const GLubyte* vendor;
 	const GLubyte* renderer;
@@ -54,10 +54,7 @@ void init() {
 	g_exampleData.camera = std::make_shared<stdgl::Camera>();
 	stdgl::useCamera(g_exampleData.camera);
 
-	auto model = stdgl::loadModel("res/DamagedHelmet.glb");
-	if(model) {
-		g_exampleData.testModel = std::make_unique<stdgl::Model>(model.value());
-	}
+	g_exampleData.testModel = stdgl::loadModelAsync("res/DamagedHelmet.glb");
 
 	g_exampleData.camera->transform = glm::translate(glm::mat4(1), glm::vec3(0, 0, -3));
 
@@ -75,6 +72,27 @@ void renderUI(const stdgl::Timestep& ts) {
 	ImGui::Text("fps: %i", stdgl::getFPS());
 	ImGui::Text("avg ms: %.2f", 1000.0f / stdgl::getFPS());
 	ImGui::Text("ms: %.2f", ts.deltaTime * 1000.0f);
+
+	stdgl::FrameStats frameStats = ts.getStats();
+	ImGui::Text("p50: %.2f  p95: %.2f  p99: %.2f  max: %.2f", frameStats.p50, frameStats.p95, frameStats.p99, frameStats.max);
+	ImGui::Text("Hitches: %u / %u", frameStats.hitchCount, frameStats.frameCount);
+	if (ImGui::Button("Export frame times")) {
+		stdgl::exportFrameTimesCSV("stdgl_frametimes.csv");
+	}
+
+	stdgl::StateCacheStats stateStats = stdgl::getStateCacheStats();
+	ImGui::Text("State calls: %u issued, %u elided", stateStats.issuedCalls, stateStats.elidedCalls);
+
+	stdgl::CullingStats cullingStats = stdgl::getCullingStats();
+	ImGui::Text("Meshes: %u visible, %u culled, %u occluded", cullingStats.visibleMeshes, cullingStats.culledMeshes, cullingStats.occludedMeshes);
+
+	stdgl::TextureCacheStats textureStats = stdgl::getTextureCacheStats();
+	ImGui::Text("Textures: %u, %.1f / %.1f MB", textureStats.residentTextures, textureStats.residentBytes / 1048576.0f, textureStats.budgetBytes / 1048576.0f);
+	ImGui::Text("Deduplicated: %u, %.1f MB saved", textureStats.deduplicatedTextures, textureStats.bytesSaved / 1048576.0f);
+
+	if (ImGui::Button("Capture CPU trace")) {
+		stdgl::captureCPUTrace("stdgl_trace.json", 10);
+	}
 	/*
 	if (g_exampleData.shouldFitDelta) {
 		ImPlot::SetNextPlotLimitsY(0, g_exampleData.maxDeltaValue * 1.1, ImGuiCond_Always);
@@ -87,6 +105,8 @@ void renderUI(const stdgl::Timestep& ts) {
 	*/
 	ImGui::End();
 
+	stdgl::showGPUProfiler();
+
 	ImGuiIO& io = ImGui::GetIO();
 	ImGuizmo::SetRect(0, 0, io.DisplaySize.x, io.DisplaySize.y);
 	ImGuizmo::Manipulate(glm::value_ptr(g_exampleData.camera->transform),
@@ -112,10 +132,14 @@ void render() {
 
 	stdgl::beginRender();
 	{
+		STDGL_GPU_ZONE("Scene");
 		stdgl::useShader("basicShader");
 		{
 
-			stdgl::drawModel(*g_exampleData.testModel);
+			if (g_exampleData.testModel->isReady()) {
+				STDGL_GPU_ZONE("Model");
+				stdgl::drawModel(g_exampleData.testModel->model);
+			}
 		}
 		stdgl::stopShader();
 	}
@@ -176,6 +200,8 @@ int main() {
 	
 	init();
 
+	stdgl::setGPUProfiling(true);
+
 	if (!stdgl::setupInput(window)) {
 		spdlog::error("Failed to setup inputs");
 		return -1;